@@ -21,11 +21,18 @@ layout (location = 0) in vec3 position;
 // projection and view matrix -> vertex coordinates will be expressed using the light position as origin
 uniform mat4 lightSpaceMatrix;
 
-// model matrix
-uniform mat4 modelMatrix;
+// transforms of the objects drawn in the frame, written by the application in a buffer texture (see include/utils/TransformRing.h)
+// for each object: 4 texels with the columns of the model matrix, and 3 texels with the columns of the normal matrix in world coordinates
+uniform samplerBuffer objectTransforms;
+// index of the object in objectTransforms (of the first copy, for instanced draws: the copies have consecutive transforms)
+uniform int objectIndex;
 
 void main()
 {
+    // we read the model matrix of the object
+    int base = (objectIndex + gl_InstanceID) * 7;
+    mat4 modelMatrix = mat4(texelFetch(objectTransforms, base), texelFetch(objectTransforms, base + 1),
+                            texelFetch(objectTransforms, base + 2), texelFetch(objectTransforms, base + 3));
 	  // we apply the transformation to express the vertex from the point of view of the light
     gl_Position = lightSpaceMatrix * modelMatrix * vec4(position, 1.0f);
 }
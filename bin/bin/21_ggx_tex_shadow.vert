@@ -21,21 +21,24 @@ layout (location = 2) in vec2 UV;
 // the numbers used for the location in the layout qualifier are the positions of the vertex attribute
 // as defined in the Mesh class
 
-// model matrix
-uniform mat4 modelMatrix;
-// view matrix
-uniform mat4 viewMatrix;
-// Projection matrix
-uniform mat4 projectionMatrix;
-
-// normals transformation matrix (= transpose of the inverse of the model-view matrix)
-uniform mat3 normalMatrix;
-
-// transformation (projection and view) matrix for the light
-uniform mat4 lightSpaceMatrix;
-
-// direction of incoming light is passed as an uniform
-uniform vec3 lightVector;
+// values shared by all the programs, written once per frame in a uniform buffer (see include/utils/FrameUniforms.h)
+// the block must have the same declaration in every shader
+layout (std140) uniform FrameUniforms {
+    // projection and view matrices of the camera
+    mat4 projectionMatrix;
+    mat4 viewMatrix;
+    // direction of incoming light
+    vec3 lightVector;
+    float Kd; // weight of diffuse reflection
+    float alpha; // rugosity - 0 : smooth, 1: rough
+    float F0; // fresnel reflectance at normal incidence
+};
+
+// transforms of the objects drawn in the frame, written by the application in a buffer texture (see include/utils/TransformRing.h)
+// for each object: 4 texels with the columns of the model matrix, and 3 texels with the columns of the normal matrix in world coordinates
+uniform samplerBuffer objectTransforms;
+// index of the object in objectTransforms (of the first copy, for instanced draws: the copies have consecutive transforms)
+uniform int objectIndex;
 
 // direction of incoming light in view coordinates
 out vec3 lightDir;
@@ -49,12 +52,21 @@ out vec3 vViewPosition;
 // the output variable for UV coordinates
 out vec2 interp_UV;
 
-// for the correct rendering of the shadows, we need to calculate the vertex coordinates also in "light coordinates" (= using light as a camera)
-out vec4 posLightSpace;
+// for the correct rendering of the shadows, we need the vertex coordinates also in "light coordinates" (= using light as a camera):
+// they are calculated in the fragment shader from the world coordinates, with the matrix of the cascade of the fragment
+out vec3 worldPosition;
 
 
 void main(){
 
+  // we read the transforms of the object
+  int base = (objectIndex + gl_InstanceID) * 7;
+  mat4 modelMatrix = mat4(texelFetch(objectTransforms, base), texelFetch(objectTransforms, base + 1),
+                          texelFetch(objectTransforms, base + 2), texelFetch(objectTransforms, base + 3));
+  // normals transformation matrix (= transpose of the inverse of the model matrix)
+  mat3 normalMatrix = mat3(texelFetch(objectTransforms, base + 4).xyz, texelFetch(objectTransforms, base + 5).xyz,
+                           texelFetch(objectTransforms, base + 6).xyz);
+
   // vertex position in world coordinates
   vec4 mPosition = modelMatrix * vec4( position, 1.0 );
   // vertex position in camera coordinates
@@ -63,8 +75,8 @@ void main(){
   // view direction, negated to have vector from the vertex to the camera
   vViewPosition = -mvPosition.xyz;
 
-  // transformations are applied to the normal
-  vNormal = normalize( normalMatrix * normal );
+  // transformations are applied to the normal (the view matrix has no scaling, so it applies to the normals as it is)
+  vNormal = normalize( mat3(viewMatrix) * normalMatrix * normal );
 
   // light incidence directions in view coordinate
   lightDir = vec3(viewMatrix  * vec4(lightVector, 0.0));
@@ -75,7 +87,7 @@ void main(){
   // I assign the values to a variable with "out" qualifier so to use the per-fragment interpolated values in the Fragment shader
   interp_UV = UV;
 
-  // vertex position in "light coordinates"
-  posLightSpace = lightSpaceMatrix * mPosition;
+  // vertex position in world coordinates, for the shadow maps
+  worldPosition = mPosition.xyz;
 
 }
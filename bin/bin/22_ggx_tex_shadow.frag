@@ -33,20 +33,42 @@ in vec3 vViewPosition;
 // interpolated texture coordinates
 in vec2 interp_UV;
 
-// for the correct rendering of the shadows, we need to calculate the vertex coordinates also in "light coordinates" (= using light as a camera)
-in vec4 posLightSpace;
+// for the correct rendering of the shadows, we need the fragment coordinates also in "light coordinates" (= using light as a camera)
+// we transform the world coordinates with the matrix of the shadow map which covers the fragment
+in vec3 worldPosition;
 
 // texture repetitions
 uniform float repeat;
 
 // texture sampler
 uniform sampler2D tex;
-// texture sampler for the depth map
-uniform sampler2D shadowMap;
-
-uniform float alpha; // rugosity - 0 : smooth, 1: rough
-uniform float F0; // fresnel reflectance at normal incidence
-uniform float Kd; // weight of diffuse reflection
+// cascaded shadow maps: each layer of the array covers a slice of the view frustum
+#define MAX_CASCADES 4
+// texture sampler for the depth maps: the texture compares a depth with the map (GL_COMPARE_REF_TO_TEXTURE), and with linear
+// filtering it returns the fraction of the 4 nearest texels which are in light
+uniform sampler2DArrayShadow shadowMap;
+// transformation (projection and view) matrices for the light, one for each cascade
+uniform mat4 cascadeMatrices[MAX_CASCADES];
+// distance from the camera of the far end of each cascade
+uniform float cascadeSplits[MAX_CASCADES];
+// size of a texel of each shadow map, and distance along the light between the depths 0 and 1 of the map (world units)
+uniform float cascadeTexelSizes[MAX_CASCADES];
+uniform float cascadeDepthRanges[MAX_CASCADES];
+// number of cascades
+uniform int cascadeCount;
+
+// values shared by all the programs, written once per frame in a uniform buffer (see include/utils/FrameUniforms.h)
+// the block must have the same declaration in every shader
+layout (std140) uniform FrameUniforms {
+    // projection and view matrices of the camera
+    mat4 projectionMatrix;
+    mat4 viewMatrix;
+    // direction of incoming light
+    vec3 lightVector;
+    float Kd; // weight of diffuse reflection
+    float alpha; // rugosity - 0 : smooth, 1: rough
+    float F0; // fresnel reflectance at normal incidence
+};
 
 ////////////////////////////////////////////////////////////////////
 
@@ -60,46 +82,123 @@ subroutine uniform shadow_map Shadow_Calculation;
 
 
 //////////////////////////////////////////
-// it applies Percentage-Closer Filtering to smooth the shadow edged. Moreover, the rendering of the areas behind the far plane of the light frustum is corrected
-subroutine(shadow_map)
-float Shadow_PCF_Final() // this name is the one which is detected by the SetupShaders() function in the main application, and the one used to swap subroutines
+// it selects the cascade which covers the fragment, and it calculates the coordinates to sample the shadow map: the texture
+// coordinates, the layer of the cascade, and the depth of the fragment (with bias) to compare with the map.
+// It returns false if the fragment is beyond the last cascade, or behind the far plane of the light frustum (= it is in light)
+bool ShadowCoordinates(out vec4 shadowCoords)
 {
+    // we select the cascade using the distance of the fragment from the camera
+    int cascade = 0;
+    while (cascade < cascadeCount && vViewPosition.z > cascadeSplits[cascade])
+        cascade++;
+    if (cascade == cascadeCount)
+        return false;
+    vec4 posLightSpace = cascadeMatrices[cascade] * vec4(worldPosition, 1.0);
+
     // given the fragment position in light coordinates, we apply the perspective divide. Usually, perspective divide is applied in an automatic way to the coordinates saved in the gl_Position variable. In this case, the vertex position in light coordinates has been saved in a separate variable, so we need to do it manually
     vec3 projCoords = posLightSpace.xyz / posLightSpace.w;
     // after the perspective divide the values are in the range [-1,1]: we must convert them in [0,1]
     projCoords = projCoords * 0.5 + 0.5;
 
-    // we get the depth of current fragment from light's perspective
-    float currentDepth = projCoords.z;
+    // To avoid that the areas behind the far plane of the light frustum are considered in shadow, we consider them in light
+    if(projCoords.z > 1.0)
+        return false;
 
-    // we calculate an adaptive bias to apply to the currentDepth value, to avoid the shadow acne effect.
-    // the bias value is in the range [0.005,0.05]: the final value is calculated considering the angle between the normal and the direction of light
+    // we calculate an adaptive bias to apply to the depth of the fragment, to avoid the shadow acne effect.
+    // the bias is in the range [1,3] texels of the cascade, considering the angle between the normal and the direction of light. It is converted
+    // in the depth units of the map, whose range contains all the casters: a constant bias in depth units would be metres with a large scene
     vec3 normal = normalize(vNormal);
-    float bias = max(0.05 * (1.0 - dot(normal, lightDir)), 0.005);
+    float bias = max(3.0 * (1.0 - dot(normal, lightDir)), 1.0) * cascadeTexelSizes[cascade] / cascadeDepthRanges[cascade];
+
+    shadowCoords = vec4(projCoords.xy, cascade, projCoords.z - bias);
+    return true;
+}
+
+//////////////////////////////////////////
+// a rotation of the Poisson disks, different for each pixel of a 4x4 tile: the banding of a few samples becomes noise.
+// The angle is given by the interleaved gradient noise (Jimenez, 2014) of the window coordinates of the fragment
+mat2 PoissonRotation()
+{
+    float angle = 2.0 * PI * fract(52.9829189 * fract(dot(gl_FragCoord.xy, vec2(0.06711056, 0.00583715))));
+    float c = cos(angle);
+    float s = sin(angle);
+    return mat2(c, s, -s, c);
+}
+
+// the radius of the Poisson disks, in texels: with the 2x2 texels of each filtered tap, they cover the same area of the 3x3 kernel
+#define POISSON_RADIUS 1.5
+const vec2 poissonDisk4[4] = vec2[](
+    vec2(-0.9420, -0.3991), vec2(0.9456, -0.7689), vec2(-0.0942, -0.9294), vec2(0.3450, 0.2939));
+const vec2 poissonDisk8[8] = vec2[](
+    vec2(-0.5079, -0.0244), vec2(-0.3866, 0.7867), vec2(0.3627, 0.0259), vec2(-0.2109, -0.5029),
+    vec2(0.2286, -0.8158), vec2(-0.7486, -0.6140), vec2(0.9401, 0.1311), vec2(0.4797, 0.6746));
+
+//////////////////////////////////////////
+// it applies Percentage-Closer Filtering to smooth the shadow edged. Each of the 3x3 taps is filtered by the texture unit (4
+// texels compared and interpolated), so the kernel covers 4x4 texels with smooth transitions
+subroutine(shadow_map)
+float Shadow_PCF_Final() // this name is the one which is detected by the SetupShaders() function in the main application, and the one used to swap subroutines
+{
+    vec4 shadowCoords;
+    if (!ShadowCoordinates(shadowCoords))
+        return 0.0;
 
-    // Version 3: we apply Percentage Close Filtering (PCF) to smooth shadow edges
-    float shadow = 0.0;
     // we determine the texel dimension
-    vec2 texelSize = 1.0 / textureSize(shadowMap, 0);
-    // we sample the depth map considering the 3x3 neighbourhood of the current fragment, and we apply the same test of Version 2 to each sample
+    vec2 texelSize = 1.0 / textureSize(shadowMap, 0).xy;
+    // we sample the depth map considering the 3x3 neighbourhood of the current fragment: each sample is the fraction in light
+    float light = 0.0;
     for(int x = -1; x <= 1; ++x)
     {
         for(int y = -1; y <= 1; ++y)
-        {
-            // we sample the depth map
-            float pcfDepth = texture(shadowMap, projCoords.xy + vec2(x, y) * texelSize).r;
-            // if the depth (with bias) of the current fragment is greater than the depth in the shadow map, then the fragment is in shadow. We add the result to the shadow variable
-            shadow += currentDepth - bias > pcfDepth  ? 1.0 : 0.0;
-        }
+            light += texture(shadowMap, shadowCoords + vec4(vec2(x, y) * texelSize, 0.0, 0.0));
     }
-    // we average the shadow result on the kernel size of the PCF
-    shadow /= 9.0;
+    // we average the result on the kernel size of the PCF
+    return 1.0 - light / 9.0;
+}
 
-    // To avoid that the areas behind the far plane of the light frustum are considered in shadow, we set their shadow value to 0 (= in light)
-    if(projCoords.z > 1.0)
-        shadow = 0.0;
+//////////////////////////////////////////
+// a single tap, filtered by the texture unit: the cheapest kernel, with the hardest edges
+subroutine(shadow_map)
+float Shadow_PCF_Bilinear()
+{
+    vec4 shadowCoords;
+    if (!ShadowCoordinates(shadowCoords))
+        return 0.0;
+    return 1.0 - texture(shadowMap, shadowCoords);
+}
 
-    return shadow;
+//////////////////////////////////////////
+// 4 filtered taps on a Poisson disk rotated for each pixel: the softness of the 3x3 kernel with less than half of the fetches
+subroutine(shadow_map)
+float Shadow_Poisson4_Rotated()
+{
+    vec4 shadowCoords;
+    if (!ShadowCoordinates(shadowCoords))
+        return 0.0;
+
+    mat2 rotation = PoissonRotation();
+    vec2 scale = POISSON_RADIUS / textureSize(shadowMap, 0).xy;
+    float light = 0.0;
+    for (int i = 0; i < 4; ++i)
+        light += texture(shadowMap, shadowCoords + vec4(rotation * poissonDisk4[i] * scale, 0.0, 0.0));
+    return 1.0 - light / 4.0;
+}
+
+//////////////////////////////////////////
+// 8 filtered taps on a rotated Poisson disk: less noise than the 4 taps
+subroutine(shadow_map)
+float Shadow_Poisson8_Rotated()
+{
+    vec4 shadowCoords;
+    if (!ShadowCoordinates(shadowCoords))
+        return 0.0;
+
+    mat2 rotation = PoissonRotation();
+    vec2 scale = POISSON_RADIUS / textureSize(shadowMap, 0).xy;
+    float light = 0.0;
+    for (int i = 0; i < 8; ++i)
+        light += texture(shadowMap, shadowCoords + vec4(rotation * poissonDisk8[i] * scale, 0.0, 0.0));
+    return 1.0 - light / 8.0;
 }
 
 //////////////////////////////////////////
@@ -0,0 +1,186 @@
+/*
+BVHBench: cost of the bounding volume hierarchy of include/utils/BVH.h over 100k instances (boxes of random size
+scattered in a cube): the SAH build, the refit after moving 1% and all of the instances, the frustum query compared
+with the linear test of every box and with the SSE2 test of every bounding sphere, and the nearest hit of a ray
+compared with the linear test of every box.
+
+The results of the queries are checked against the linear tests.
+Build it with "make bench" and run it from bin/bin.
+*/
+
+#include <utils/BVH.h>
+#include <utils/FrustumCuller.h>
+#include <utils/ParticleRandom.h>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <vector>
+
+#define NUM_INSTANCES	100000
+#define WORLD_SIZE		1000.0f
+#define NUM_VIEWS		64
+#define NUM_RAYS		10000
+
+typedef std::chrono::high_resolution_clock Clock;
+
+double elapsedMs(Clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+SnowGL::AABB instanceBox(const float values[4], const glm::vec3 &offset)
+{
+    glm::vec3 center = WORLD_SIZE * glm::vec3(values[0], values[1], values[2]) + offset;
+    float size = 0.5f + 2.5f * values[3];
+    SnowGL::AABB box;
+    box.expand(center - size);
+    box.expand(center + size);
+    return box;
+}
+
+int main()
+{
+    SnowGL::ParticleRandom random(22);
+    std::vector<SnowGL::AABB> boxes(NUM_INSTANCES);
+    SnowGL::SphereSet spheres;
+    for (uint32_t i = 0; i < NUM_INSTANCES; i++) {
+        float values[4];
+        random.uniform(i, 0, values);
+        boxes[i] = instanceBox(values, glm::vec3(0.0f));
+        SnowGL::BoundingSphere sphere;
+        sphere.center = boxes[i].getCenter();
+        sphere.radius = glm::length(boxes[i].getExtents());
+        spheres.push(sphere);
+    }
+
+    SnowGL::BVH bvh;
+    Clock::time_point start = Clock::now();
+    bvh.build(boxes);
+    double buildMs = elapsedMs(start);
+    float buildCost = bvh.getCost();
+
+    // 1% of the instances move by a few units, then all of them
+    start = Clock::now();
+    for (uint32_t i = 0; i < NUM_INSTANCES; i += 100) {
+        float values[4];
+        random.uniform(i, 0, values);
+        bvh.setBounds(i, instanceBox(values, glm::vec3(2.0f, 0.0f, 1.0f)));
+    }
+    bvh.refit();
+    double refitFewMs = elapsedMs(start);
+
+    start = Clock::now();
+    for (uint32_t i = 0; i < NUM_INSTANCES; i++) {
+        float values[4];
+        random.uniform(i, 0, values);
+        boxes[i] = instanceBox(values, glm::vec3(0.0f, 1.0f, 3.0f));
+        bvh.setBounds(i, boxes[i]);
+    }
+    bvh.refit();
+    double refitAllMs = elapsedMs(start);
+    for (uint32_t i = 0; i < NUM_INSTANCES; i++) {
+        spheres.x[i] = boxes[i].getCenter().x;
+        spheres.y[i] = boxes[i].getCenter().y;
+        spheres.z[i] = boxes[i].getCenter().z;
+    }
+
+    // cameras inside the cube, looking in random directions
+    std::vector<SnowGL::FrustumCuller> views(NUM_VIEWS);
+    glm::mat4 projection = glm::perspective(glm::radians(45.0f), 16.0f / 9.0f, 0.1f, 300.0f);
+    for (uint32_t i = 0; i < NUM_VIEWS; i++) {
+        float values[4];
+        random.uniform(i, 1, values);
+        glm::vec3 eye = WORLD_SIZE * glm::vec3(values[0], values[1], values[2]);
+        float angle = glm::radians(360.0f * values[3]);
+        views[i].setViewProjection(projection * glm::lookAt(eye, eye + glm::vec3(cos(angle), 0.0f, sin(angle)), glm::vec3(0.0f, 1.0f, 0.0f)));
+    }
+
+    std::vector<uint32_t> visible, expected;
+    size_t linearFound = 0, sphereFound = 0, bvhFound = 0;
+    unsigned long long bvhNodes = 0;
+    bool same = true;
+    start = Clock::now();
+    for (SnowGL::FrustumCuller &view : views) {
+        for (uint32_t i = 0; i < NUM_INSTANCES; i++) {
+            unsigned planes = SnowGL::FrustumCuller::ALL_PLANES;
+            linearFound += view.classify(boxes[i], planes) != SnowGL::FrustumCuller::OUTSIDE;
+        }
+    }
+    double linearMs = elapsedMs(start) / NUM_VIEWS;
+
+    start = Clock::now();
+    for (SnowGL::FrustumCuller &view : views)
+        sphereFound += view.cull(spheres, visible);
+    double sphereMs = elapsedMs(start) / NUM_VIEWS;
+
+    start = Clock::now();
+    for (SnowGL::FrustumCuller &view : views) {
+        bvhFound += bvh.queryFrustum(view, visible);
+        bvhNodes += bvh.getStats().nodes;
+    }
+    double bvhMs = elapsedMs(start) / NUM_VIEWS;
+
+    for (SnowGL::FrustumCuller &view : views) {
+        expected.clear();
+        for (uint32_t i = 0; i < NUM_INSTANCES; i++) {
+            unsigned planes = SnowGL::FrustumCuller::ALL_PLANES;
+            if (view.classify(boxes[i], planes) != SnowGL::FrustumCuller::OUTSIDE)
+                expected.push_back(i);
+        }
+        bvh.queryFrustum(view, visible);
+        std::sort(visible.begin(), visible.end());
+        same = same && visible == expected;
+    }
+
+    // rays from random points in random directions, with the nearest box hit
+    std::vector<glm::vec3> origins(NUM_RAYS), directions(NUM_RAYS);
+    for (uint32_t i = 0; i < NUM_RAYS; i++) {
+        float values[4], angles[4];
+        random.uniform(i, 2, values);
+        random.uniform(i, 3, angles);
+        origins[i] = WORLD_SIZE * glm::vec3(values[0], values[1], values[2]);
+        float theta = glm::radians(360.0f * angles[0]), z = 2.0f * angles[1] - 1.0f;
+        directions[i] = glm::vec3(sqrt(1.0f - z * z) * cos(theta), sqrt(1.0f - z * z) * sin(theta), z);
+    }
+    auto acceptBox = [](uint32_t, float tBox, float &t) {
+        if (tBox >= t)
+            return false;
+        t = tBox;
+        return true;
+    };
+
+    std::vector<float> linearHits(NUM_RAYS), bvhHits(NUM_RAYS);
+    start = Clock::now();
+    for (uint32_t r = 0; r < NUM_RAYS; r++) {
+        glm::vec3 inverseDirection = 1.0f / directions[r];
+        float t = WORLD_SIZE, tNear;
+        for (uint32_t i = 0; i < NUM_INSTANCES; i++)
+            if (boxes[i].intersectRay(origins[r], inverseDirection, t, tNear) && tNear < t)
+                t = tNear;
+        linearHits[r] = t;
+    }
+    double linearRayUs = 1000.0 * elapsedMs(start) / NUM_RAYS;
+
+    start = Clock::now();
+    for (uint32_t r = 0; r < NUM_RAYS; r++)
+        bvh.queryRay(origins[r], directions[r], WORLD_SIZE, acceptBox, bvhHits[r]);
+    double bvhRayUs = 1000.0 * elapsedMs(start) / NUM_RAYS;
+    bool sameHits = linearHits == bvhHits;
+
+    printf("%d instances, %zu nodes\n", NUM_INSTANCES, bvh.getNodeCount());
+    printf("%-36s %10.2f ms (SAH cost %.1f)\n", "build", buildMs, buildCost);
+    printf("%-36s %10.2f ms\n", "refit, 1% moved", refitFewMs);
+    printf("%-36s %10.2f ms (SAH cost %.1f)\n", "refit, all moved", refitAllMs, bvh.getCost());
+    printf("frustum query, %d views, %.0f visible on average\n", NUM_VIEWS, (double)bvhFound / NUM_VIEWS);
+    printf("%-36s %10.3f ms/view\n", "linear, boxes", linearMs);
+    printf("%-36s %10.3f ms/view (%.0f visible)\n", "linear, spheres (SSE2)", sphereMs, (double)sphereFound / NUM_VIEWS);
+    printf("%-36s %10.3f ms/view (%.0f nodes, %s)\n", "BVH", bvhMs, (double)bvhNodes / NUM_VIEWS, same ? "identical" : "MISMATCH");
+    printf("ray query, %d rays, nearest hit\n", NUM_RAYS);
+    printf("%-36s %10.2f us/ray\n", "linear, boxes", linearRayUs);
+    printf("%-36s %10.2f us/ray (%s)\n", "BVH", bvhRayUs, sameHits ? "identical" : "MISMATCH");
+    printf("(checksum %zu)\n", linearFound);
+    return 0;
+}
@@ -0,0 +1,97 @@
+/*
+ParticleLayoutBench: update cost of the CPU particles, array-of-structs (the original layout of rain.cpp)
+versus the structure-of-arrays store in include/utils/ParticleStore.h
+
+It prints, for a growing number of particles, the nanoseconds spent per particle update with each layout.
+Build it with "make bench" and run it from bin/bin.
+*/
+
+#include <utils/ParticleStore.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+// the particle struct used by rain.cpp before the SoA store
+typedef struct {
+  bool alive;
+  float life;
+  float fade;
+  float red;
+  float green;
+  float blue;
+  float xpos;
+  float ypos;
+  float zpos;
+  float vel;
+  float gravity;
+} particles;
+
+typedef std::chrono::high_resolution_clock Clock;
+
+// we keep the compiler from discarding the updates
+volatile float sink;
+
+double benchAoS(size_t count, int iterations)
+{
+    std::vector<particles> par_sys(count);
+    for (size_t i = 0; i < count; i++) {
+        par_sys[i].alive = true;
+        par_sys[i].life = 1.0f;
+        par_sys[i].fade = float(rand()%100)/1000.0f+0.003f;
+        par_sys[i].ypos = 10.0f;
+        par_sys[i].vel = 0.0f;
+        par_sys[i].gravity = -0.8f;
+    }
+
+    Clock::time_point start = Clock::now();
+    for (int it = 0; it < iterations; it++) {
+        for (size_t i = 0; i < count; i++) {
+            if (par_sys[i].alive == true) {
+                par_sys[i].ypos += par_sys[i].vel / (2.0f*1000);
+                par_sys[i].vel += par_sys[i].gravity;
+                par_sys[i].life -= par_sys[i].fade;
+            }
+        }
+    }
+    double ns = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+    sink = par_sys[count/2].ypos;
+    return ns / (double(count) * iterations);
+}
+
+double benchSoA(size_t count, int iterations)
+{
+    SnowGL::ParticleStore par_sys(count);
+    size_t i;
+    while (par_sys.spawn(i)) {
+        par_sys.life[i] = 1.0f;
+        par_sys.fade[i] = float(rand()%100)/1000.0f+0.003f;
+        par_sys.ypos[i] = 10.0f;
+        par_sys.gravity[i] = -0.8f;
+    }
+
+    Clock::time_point start = Clock::now();
+    for (int it = 0; it < iterations; it++)
+        par_sys.integrate(2.0f*1000);
+    double ns = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+    sink = par_sys.ypos[count/2];
+    return ns / (double(count) * iterations);
+}
+
+int main()
+{
+    const size_t counts[] = { 1000, 10000, 100000, 1000000, 4000000 };
+
+    printf("SoA kernel: %s\n", SnowGL::ParticleStore::getKernelName());
+    printf("%10s %14s %14s %8s\n", "particles", "AoS ns/part", "SoA ns/part", "speedup");
+    for (size_t c = 0; c < sizeof(counts) / sizeof(counts[0]); c++) {
+        // roughly the same amount of work for every size
+        int iterations = (int)(40000000 / counts[c]);
+        if (iterations < 10) iterations = 10;
+        double aos = benchAoS(counts[c], iterations);
+        double soa = benchSoA(counts[c], iterations);
+        printf("%10zu %14.3f %14.3f %7.2fx\n", counts[c], aos, soa, aos / soa);
+    }
+    return 0;
+}
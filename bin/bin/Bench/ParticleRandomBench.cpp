@@ -0,0 +1,75 @@
+/*
+ParticleRandomBench: cost of seeding 1M particles with 4 random values each, using rand() (as before),
+the counter-based generator in include/utils/ParticleRandom.h one particle at a time, its SSE2 batch
+generation, and the batch generation split on the job pool.
+
+The parallel run is checked to give the same values as the serial one.
+Build it with "make bench" and run it from bin/bin.
+*/
+
+#include <utils/ParticleRandom.h>
+#include <utils/JobPool.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#define NUM_PARTICLES	1000000
+#define SPAWN_CHUNK		16384
+
+typedef std::chrono::high_resolution_clock Clock;
+
+double elapsedMs(Clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+int main()
+{
+    std::vector<float> u0(NUM_PARTICLES), u1(NUM_PARTICLES), u2(NUM_PARTICLES), u3(NUM_PARTICLES);
+    std::vector<float> p0(NUM_PARTICLES), p1(NUM_PARTICLES), p2(NUM_PARTICLES), p3(NUM_PARTICLES);
+    SnowGL::ParticleRandom random(161);
+    SnowGL::JobPool pool;
+
+    Clock::time_point start = Clock::now();
+    for (size_t i = 0; i < NUM_PARTICLES; i++) {
+        u0[i] = (float)rand() / RAND_MAX;
+        u1[i] = (float)rand() / RAND_MAX;
+        u2[i] = (float)rand() / RAND_MAX;
+        u3[i] = (float)rand() / RAND_MAX;
+    }
+    double randMs = elapsedMs(start);
+
+    start = Clock::now();
+    for (size_t i = 0; i < NUM_PARTICLES; i++) {
+        float values[4];
+        random.uniform((uint32_t)i, 0, values);
+        u0[i] = values[0];
+        u1[i] = values[1];
+        u2[i] = values[2];
+        u3[i] = values[3];
+    }
+    double scalarMs = elapsedMs(start);
+
+    start = Clock::now();
+    random.uniformBatch(0, NUM_PARTICLES, 0, u0.data(), u1.data(), u2.data(), u3.data());
+    double batchMs = elapsedMs(start);
+
+    start = Clock::now();
+    pool.parallelFor(NUM_PARTICLES, SPAWN_CHUNK, [&](size_t begin, size_t end) {
+        random.uniformBatch((uint32_t)begin, end - begin, 0, &p0[begin], &p1[begin], &p2[begin], &p3[begin]);
+    });
+    double parallelMs = elapsedMs(start);
+
+    bool same = memcmp(u0.data(), p0.data(), NUM_PARTICLES * sizeof(float)) == 0 &&
+                memcmp(u3.data(), p3.data(), NUM_PARTICLES * sizeof(float)) == 0;
+
+    printf("%d particles, 4 values each\n", NUM_PARTICLES);
+    printf("%-28s %10.2f ms\n", "rand()", randMs);
+    printf("%-28s %10.2f ms\n", "Philox, one at a time", scalarMs);
+    printf("%-28s %10.2f ms\n", "Philox, SSE2 batch", batchMs);
+    printf("%-28s %10.2f ms (%u threads, %s)\n", "Philox, batch on job pool", parallelMs, pool.getThreadCount(), same ? "identical" : "MISMATCH");
+    return 0;
+}
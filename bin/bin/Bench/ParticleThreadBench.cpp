@@ -0,0 +1,78 @@
+/*
+ParticleThreadBench: scaling of the chunked particle update (include/utils/JobPool.h) with the number of threads
+
+For each thread count it prints the particle throughput and the speedup over a single thread, and it checks
+that the updated streams are bit-identical to the single thread run.
+Build it with "make bench" and run it from bin/bin.
+*/
+
+#include <utils/ParticleStore.h>
+#include <utils/JobPool.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+
+#define NUM_PARTICLES	4000000
+#define UPDATE_CHUNK	16384
+#define ITERATIONS		50
+
+typedef std::chrono::high_resolution_clock Clock;
+
+void initStore(SnowGL::ParticleStore &par_sys)
+{
+    srand(1);
+    size_t i;
+    while (par_sys.spawn(i)) {
+        par_sys.life[i] = 1.0f;
+        par_sys.fade[i] = float(rand()%100)/1000.0f+0.003f;
+        par_sys.ypos[i] = 10.0f;
+        par_sys.vel[i] = float(rand()%100)/10.0f;
+        par_sys.gravity[i] = -0.8f;
+    }
+}
+
+// it returns the particles updated per second
+double runUpdate(SnowGL::ParticleStore &par_sys, unsigned threads)
+{
+    SnowGL::JobPool pool(threads);
+    Clock::time_point start = Clock::now();
+    for (int it = 0; it < ITERATIONS; it++) {
+        pool.parallelFor(par_sys.getAliveCount(), UPDATE_CHUNK, [&par_sys](size_t begin, size_t end) {
+            par_sys.reflectBelow(begin, end, -10);
+            par_sys.integrate(begin, end, 2.0f*1000);
+        });
+    }
+    double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    return double(par_sys.getSize()) * ITERATIONS / seconds;
+}
+
+bool sameStreams(const SnowGL::ParticleStore &a, const SnowGL::ParticleStore &b)
+{
+    size_t bytes = a.getSize() * sizeof(float);
+    return memcmp(a.ypos, b.ypos, bytes) == 0 && memcmp(a.vel, b.vel, bytes) == 0 && memcmp(a.life, b.life, bytes) == 0;
+}
+
+int main()
+{
+    unsigned maxThreads = std::thread::hardware_concurrency();
+    if (maxThreads == 0) maxThreads = 1;
+
+    SnowGL::ParticleStore reference(NUM_PARTICLES);
+    initStore(reference);
+    double base = runUpdate(reference, 1);
+
+    printf("%d particles, chunks of %d, kernel %s\n", NUM_PARTICLES, UPDATE_CHUNK, SnowGL::ParticleStore::getKernelName());
+    printf("%8s %16s %8s %10s\n", "threads", "Mparticles/s", "speedup", "identical");
+    printf("%8u %16.1f %7.2fx %10s\n", 1u, base / 1e6, 1.0, "yes");
+    // we double the thread count, but always end with maxThreads, which is not always a power of two
+    for (unsigned threads = 2; threads <= maxThreads; threads = threads < maxThreads && threads * 2 > maxThreads ? maxThreads : threads * 2) {
+        SnowGL::ParticleStore par_sys(NUM_PARTICLES);
+        initStore(par_sys);
+        double rate = runUpdate(par_sys, threads);
+        printf("%8u %16.1f %7.2fx %10s\n", threads, rate / 1e6, rate / base, sameStreams(reference, par_sys) ? "yes" : "NO");
+    }
+    return 0;
+}
@@ -0,0 +1,131 @@
+/*
+UniformLookupBench: CPU cost of GLSLProgram::setUniform by name, with the std::map<std::string, int> lookup
+used before (find, then two operator[] with a std::string built from the name) and with the open-addressed
+table of hashed names, both with a handle built from the literal at the call and with a constexpr handle.
+
+The OpenGL calls are replaced by stubs (no context is needed): the program reports the uniforms of
+particles_shader.vert, and glUniform1f only records the location, which is checked against the expected one.
+Build it with "make bench" and run it from bin/bin.
+*/
+
+// glad and GLSLProgram are compiled with the benchmark, so "make bench" needs no other sources
+#include <glad/glad.c>
+#include <utils/glslprogram.cpp>
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <string>
+
+#define ITERATIONS 10000000
+
+typedef std::chrono::high_resolution_clock Clock;
+
+// the active uniforms of the stub program (the location is the index)
+const char *uniformNames[] = { "Time", "H", "Interp", "Accel", "EmitPeriod", "DomainMin", "DomainSize", "ParticleTex" };
+const int uniformCount = sizeof(uniformNames) / sizeof(uniformNames[0]);
+
+GLint lastLocation = -1;
+long long locationSum = 0;
+
+void APIENTRY stubGetProgramiv(GLuint, GLenum pname, GLint *params)
+{
+    if (pname == GL_ACTIVE_UNIFORMS)
+        *params = uniformCount;
+    else if (pname == GL_ACTIVE_UNIFORM_MAX_LENGTH)
+        *params = 32;
+}
+
+void APIENTRY stubGetActiveUniform(GLuint, GLuint index, GLsizei bufSize, GLsizei *length, GLint *size, GLenum *type, GLchar *name)
+{
+    strncpy(name, uniformNames[index], bufSize);
+    *length = (GLsizei)strlen(name);
+    *size = 1;
+    *type = GL_FLOAT;
+}
+
+GLint APIENTRY stubGetUniformLocation(GLuint, const GLchar *name)
+{
+    for (int i = 0; i < uniformCount; i++)
+        if (strcmp(name, uniformNames[i]) == 0)
+            return i;
+    return -1;
+}
+
+void APIENTRY stubUniform1f(GLint location, GLfloat)
+{
+    lastLocation = location;
+    locationSum += location;
+}
+
+// the lookup of GLSLProgram before the hashed table
+std::map<std::string, int> uniformLocations;
+
+int mapUniformLocation(const char *name)
+{
+    auto pos = uniformLocations.find(name);
+
+    if (pos == uniformLocations.end()) {
+        uniformLocations[name] = glGetUniformLocation(0, name);
+    }
+
+    return uniformLocations[name];
+}
+
+double nsPerCall(Clock::time_point start)
+{
+    return std::chrono::duration<double, std::nano>(Clock::now() - start).count() / ITERATIONS;
+}
+
+int main()
+{
+    glad_glGetProgramiv = stubGetProgramiv;
+    glad_glGetActiveUniform = stubGetActiveUniform;
+    glad_glGetUniformLocation = stubGetUniformLocation;
+    glad_glUniform1f = stubUniform1f;
+
+    GLSLProgram program;
+    program.findUniformLocations();
+
+    // every name must give its location, and a name not in the program must give -1
+    for (int i = 0; i < uniformCount; i++) {
+        program.setUniform(uniformNames[i], 0.0f);
+        if (lastLocation != i) {
+            printf("ERROR: %s has location %d, expected %d\n", uniformNames[i], lastLocation, i);
+            return 1;
+        }
+    }
+    program.setUniform("Missing", 0.0f);
+    if (lastLocation != -1) {
+        printf("ERROR: an inactive uniform has location %d\n", lastLocation);
+        return 1;
+    }
+
+    // the uniforms set in each step of the particle update
+    Clock::time_point start = Clock::now();
+    for (int i = 0; i < ITERATIONS; i++) {
+        glUniform1f(mapUniformLocation(i & 1 ? "Time" : "EmitPeriod"), 0.0f);
+    }
+    double mapNs = nsPerCall(start);
+
+    start = Clock::now();
+    for (int i = 0; i < ITERATIONS; i++) {
+        program.setUniform(i & 1 ? "Time" : "EmitPeriod", 0.0f);
+    }
+    double literalNs = nsPerCall(start);
+
+    constexpr GLSLUniform time("Time"), emitPeriod("EmitPeriod");
+    start = Clock::now();
+    for (int i = 0; i < ITERATIONS; i++) {
+        program.setUniform(i & 1 ? time : emitPeriod, 0.0f);
+    }
+    double handleNs = nsPerCall(start);
+
+    printf("setUniform, %d calls (glUniform1f is a stub)\n", ITERATIONS);
+    printf("std::map<std::string, int>    %7.2f ns/call\n", mapNs);
+    printf("hashed table, literal name    %7.2f ns/call\n", literalNs);
+    printf("hashed table, constexpr name  %7.2f ns/call\n", handleNs);
+    printf("(checksum %lld)\n", locationSum);
+    return 0;
+}
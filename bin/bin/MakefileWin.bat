@@ -7,4 +7,4 @@ IF EXIST "C:\Program Files (x86)\Microsoft Visual Studio\2019\BuildTools\VC\Auxi
 set compilerflags=/Od /Zi /EHsc /MT
 set includedirs=/I../../include
 set linkerflags=/LIBPATH:../../libs/win glfw3.lib assimp-vc142-mt.lib zlib.lib IrrXML.lib gdi32.lib user32.lib Shell32.lib
-cl.exe %compilerflags% %includedirs% ../../include/glad/glad.c ../../include/utils/glslprogram.cpp ../../include/utils/glutils.cpp RainSnow.cpp /Fe:RainSnow.exe /link %linkerflags% 
+cl.exe %compilerflags% %includedirs% ../../include/glad/glad.c ../../include/utils/glslprogram.cpp ../../include/utils/glutils.cpp ../../include/utils/ParticleSettings.cpp ../../include/utils/BenchScenario.cpp RainSnow.cpp /Fe:RainSnow.exe /link %linkerflags% 
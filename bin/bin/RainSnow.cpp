@@ -50,6 +50,10 @@ positive Z axis points "outside" the screen
 
 // Std. Includes
 #include <string>
+#include <fstream>
+#include <sstream>
+#include <cstring>
+#include <algorithm>
 
 // Loader for OpenGL extensions
 // http://glad.dav1d.de/
@@ -65,6 +69,11 @@ positive Z axis points "outside" the screen
 // GLFW library to create window and to manage I/O
 #include <glfw/glfw3.h>
 
+#ifdef RAINSNOW_HEADLESS
+// EGL context without a window, for the --headless mode
+#include <utils/HeadlessContext.h>
+#endif
+
 // another check related to OpenGL loader
 // confirm that GLAD didn't include windows.h
 #ifdef _WINDOWS_
@@ -76,9 +85,29 @@ positive Z axis points "outside" the screen
 #include <utils/model_v1.h>
 #include <utils/camera.h>
 #include <utils/glslprogram.h>
+#include <utils/SimulationClock.h>
+#include <utils/ParticleSettings.h>
+#include <utils/ParticleEmitter.h>
+#include <utils/ParticleRandom.h>
+#include <utils/JobPool.h>
+#include <utils/FileWatcher.h>
+#include <utils/ParticlePool.h>
+#include <utils/ParticlePacking.h>
+#include <utils/BenchScenario.h>
+#include <utils/BenchReport.h>
+#include <utils/GpuTimer.h>
+#include <utils/FrameUniforms.h>
+#include <utils/TransformRing.h>
+#include <utils/RenderList.h>
+#include <utils/FrustumCuller.h>
+#include <utils/BVH.h>
+#include <utils/ShadowCache.h>
+#include <utils/ShadowCascades.h>
+#include <utils/Profiler.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <math.h>
+#include <chrono>
 
 // we load the GLM classes used in the application
 #include <glm/glm.hpp>
@@ -134,18 +163,55 @@ void apply_camera_movements();
 GLuint current_subroutine = 0;
 // a vector for all the shader subroutines names used and swapped in the application
 vector<std::string> shaders;
+// the indices of the subroutines in the shaders vector, resolved once in SetupShader()
+vector<GLuint> shaderIndices;
+// the shadow kernel selected with --shadow-kernel <name> (a subroutine of the illumination shader); with "all", the kernels
+// are used in turn, one per frame. The benchmark report has the GPU time of the scene pass of each kernel used
+std::string shadowKernelOption;
+bool cycleShadowKernels = false;
+// the kernel of the last frames, to match their GPU times which arrive a few frames later (the results of a frame
+// are collected at most GpuTimer::FRAMES frames after it)
+GLuint frameShadowKernels[SnowGL::GpuTimer::FRAMES + 1];
+
+// handles of the uniforms of the illumination shader, resolved once after the link
+// (the values shared with the other programs are in the FrameUniforms block)
+struct IlluminationUniforms
+{
+    UniformHandle<GLfloat> repeat;
+    UniformHandle<GLint> tex, shadowMap, objectTransforms, objectIndex, cascadeCount;
+    UniformHandle<glm::mat4> cascadeMatrices;
+    UniformHandle<GLfloat> cascadeSplits, cascadeTexelSizes, cascadeDepthRanges;
+} illuminationUniforms;
+// it resolves the handles of illuminationUniforms
+void ResolveIlluminationUniforms(const Shader &shader);
+// handles of the uniforms of the shader of the shadow map
+struct ShadowUniforms
+{
+    UniformHandle<GLint> objectTransforms, objectIndex;
+    UniformHandle<glm::mat4> lightSpaceMatrix;
+} shadowUniforms;
+// it resolves the handles of shadowUniforms
+void ResolveShadowUniforms(const Shader &shader);
 
 // the name of the subroutines are searched in the shaders, and placed in the shaders vector (to allow shaders swapping)
 void SetupShader(int shader_program, bool isParticleShader);
 
-void CompileAndLinkShader();
+void CompileAndLinkShader(GLSLProgram &program);
+// it loads a shader source, adding a #define after the #version line for each name in defines
+std::string LoadShaderSource(const char* path, const std::vector<std::string> &defines);
+// it compiles the compute shader of the particle update
+void CompileComputeShader(GLSLProgram &program);
+// it sets the uniforms which depend on the particle settings
+void SetParticleUniforms(GLSLProgram &program);
     
 
 // print on console the name of current shader subroutine
 void PrintCurrentShader(int subroutine);
 
 // in this application, we have isolated the models rendering using a function, which will be called in each rendering step
-void RenderObjects(Shader &shader, Model &planeModel, Model &benchModel, Model &lampModel, Model &treeModel, GLint render_pass, GLuint depthMap);
+void RenderObjects(Shader &shader, GLint render_pass, GLuint depthMap);
+// it renders in the shadow map the static objects (the first time, and when the light changes), or those which spin
+void RenderShadowCasters(Shader &shader, int cascade, bool staticCasters);
 
 // load image from disk and create an OpenGL texture
 GLint LoadTexture(const char* path);
@@ -153,8 +219,15 @@ GLint LoadTexture(const char* path);
 // we initialize an array of booleans for each keybord key
 bool keys[1024];
 
-void initBuffers();
+void initBuffers(int count);
+// it times the update and render passes of the separate and interleaved layouts, and prints the results
+void RunLayoutBenchmark();
+void fillParticleSlots(int first, int count, float firstStartTime);
+void writeParticleLifetimes(int first, int count);
+void reloadParticleSettings();
 void renderParticles();
+// seconds elapsed since the start of the application
+double GetTime();
 
 // we need to store the previous mouse position to calculate the offset with the current frame
 GLfloat lastX, lastY;
@@ -176,15 +249,83 @@ GLboolean wireframe = GL_FALSE;
 // View matrix: the camera moves, so we just set to indentity now
 glm::mat4 view = glm::mat4(1.0f);
 
-// Model and Normal transformation matrices for the objects in the scene: we set to identity
-glm::mat4 lampModelMatrix = glm::mat4(1.0f);
-glm::mat3 lampNormalMatrix = glm::mat3(1.0f);
-glm::mat4 benchModelMatrix = glm::mat4(1.0f);
-glm::mat3 benchNormalMatrix = glm::mat3(1.0f);
-glm::mat4 treeModelMatrix = glm::mat4(1.0f);
-glm::mat3 treeNormalMatrix = glm::mat3(1.0f);
-glm::mat4 planeModelMatrix = glm::mat4(1.0f);
-glm::mat3 planeNormalMatrix = glm::mat3(1.0f);
+// the objects in the scene: a model, with its material and its placement
+struct Prop
+{
+    Model *model;
+    int material;           // id of the material in renderList
+    glm::vec3 position;
+    glm::vec3 scale;
+    bool spins;             // if true, it is rotated by orientationY around the Y axis
+    // if not empty, the static transforms of the copies of the model, drawn with instancing (position, scale and spins are not used)
+    vector<SnowGL::ObjectTransform> instances;
+    glm::mat4 modelMatrix;  // model matrix in the current frame (of an object without copies)
+    uint32_t firstPrimitive;    // id of its box (of the box of the first copy) in sceneBVH
+    GLint object;           // index of its transforms (of the first copy) in transformRing, in the current frame
+    GLsizei visibleInstances;   // number of copies inside the view frustum, with consecutive transforms in transformRing
+    // the same for the copies inside the light frustum of each cascade, if it is rendered in the current frame
+    GLint shadowObject[SnowGL::ShadowCascades::MAX_CASCADES];
+    GLsizei shadowInstances[SnowGL::ShadowCascades::MAX_CASCADES];
+};
+vector<Prop> props;
+// it adds an object to the scene
+void AddProp(Model &model, int material, glm::vec3 position, glm::vec3 scale, bool spins);
+// it adds the copies of a model to the scene, with their model matrices
+void AddPropInstances(Model &model, int material, const vector<glm::mat4> &modelMatrices);
+// if not 0 (--forest N), N trees are scattered on the plane, and drawn with instancing
+int forestTrees = 0;
+#define FOREST_SEED 7
+// the draws of the scene, sorted by program, material and VAO before the submission
+SnowGL::RenderList renderList;
+// id of the illumination shader in renderList
+int illuminationProgram = -1;
+// the transforms of the objects are written once per frame in a ring buffer, read by the shaders through a buffer texture
+// bound at TRANSFORM_UNIT: a draw selects its object with the index in the ring
+SnowGL::TransformRing transformRing;
+#define TRANSFORM_UNIT 4
+// the props placed besides the forest: with the trees, they give the size of the ring
+#define SCENE_PROPS 4
+// it computes the model matrices of the objects, and writes them in the ring
+void UpdateObjectTransforms();
+// the bounding spheres of the meshes and of the copies are tested against the view frustum, so the objects outside
+// the view are neither written in the ring nor drawn
+SnowGL::FrustumCuller culler;
+// the meshes drawn and culled in the current frame (a mesh of a copy counts once for each copy)
+unsigned int frameMeshesDrawn = 0, frameMeshesCulled = 0;
+// the nodes of sceneBVH visited by the query of the camera, and the objects (copies) rendered in the shadow map, in the current frame
+unsigned int frameBVHNodes = 0, frameShadowCasters = 0;
+// the hierarchy of the boxes of the objects and of the copies, in world coordinates: the boxes of the objects which
+// spin are updated at each frame, and the tree is refitted. It gives the objects inside the view frustum
+SnowGL::BVH sceneBVH;
+// it computes the model matrix of an object without copies
+glm::mat4 PropModelMatrix(const Prop &prop);
+// it builds sceneBVH, after the last object has been added
+void BuildSceneBVH();
+// it writes in the ring the transforms of the objects (copies) selected by the boxes in visible (sorted by id): those
+// inside the view frustum (cascade -1), or the shadow casters inside the light frustum of a cascade
+void WriteVisibleTransforms(const vector<uint32_t> &visible, int cascade);
+
+// cascaded shadow maps: the camera frustum, up to SHADOW_DISTANCE, is split in slices, each covered by a shadow map
+// (a layer of a texture array). The first cascade is rendered at each frame, the others in turn every
+// cascadeUpdatePeriod frames (--cascades N, --cascade-period N)
+SnowGL::ShadowCascades shadowCascades;
+int cascadeCount = 3;
+int cascadeUpdatePeriod = 4;
+#define SHADOW_DISTANCE 100.0f
+// the shadow maps: in each layer, the static objects are rendered in a cache only when the light matrix of the cascade
+// changes, and the cache is copied in the shadow map at each update, before the rendering of the objects which spin
+SnowGL::ShadowCache shadowCache;
+// the box containing the objects in any orientation (an object which spins is bounded by its sphere)
+SnowGL::AABB shadowBounds;
+// the light frustum of a cascade, for the culling of the shadow casters
+SnowGL::FrustumCuller lightCuller;
+// id of the shader of the shadow map in renderList
+int shadowProgram = -1;
+// the cascades rendered in the current frame
+unsigned int frameCascadeUpdates = 0;
+// it writes in the ring the transforms of the shadow casters inside the light frustum of a cascade: the static ones
+// only when the cache is rendered, those which spin at each update
+void UpdateShadowCasterTransforms(int cascade, bool staticCasters);
 
 // we create a camera. We pass the initial position as a paramenter to the constructor. The last boolean tells if we want a camera "anchored" to the ground
 Camera camera(glm::vec3(0.0f, 0.0f, 7.0f), GL_TRUE);
@@ -205,65 +346,266 @@ vector<GLint> textureID;
 // UV repetitions
 GLfloat repeat = 1.0;
 
-GLuint posBuf[2], velBuf[2];
-GLuint particleArray[2];
-GLuint feedback[2], initVel, startTime[2];
+// the particle attributes, in the order of their locations in particles_shader.vert
+enum particle_streams{ PARTICLE_POSITION, PARTICLE_VELOCITY, PARTICLE_START_TIME, PARTICLE_INIT_VELOCITY, PARTICLE_LIFETIME };
+// the same for the packed format (PACKED_PARTICLES in particles_shader.vert)
+enum packed_particle_streams{ PACKED_STATE, PACKED_INIT_VELOCITY, PACKED_LIFETIME };
+// if true (--packed on the command line), the particles use the packed format: position in unorm16
+// relative to the particle domain, velocities in half floats
+bool packedParticles = false;
+// if true (--interleaved), position, velocity and start time of a set are interleaved in a single buffer,
+// captured with GL_INTERLEAVED_ATTRIBS
+bool interleavedParticles = false;
+// if true (--layout-bench), the application runs RunLayoutBenchmark() and exits
+bool layoutBenchmark = false;
+// the particle update runs in a compute shader if OpenGL 4.3 is available (unless --backend feedback is given),
+// otherwise in the vertex shader with transform feedback
+enum particle_backends{ FEEDBACK_BACKEND, COMPUTE_BACKEND };
+int particleBackend = COMPUTE_BACKEND;
+// if true (--headless), there is no window: the frames are rendered in a framebuffer object of the size of the window,
+// and the application exits after headlessFrames frames (--frames N). It needs the headless build (make headless)
+bool headless = false;
+int headlessFrames = 600;
+// the framebuffer of the final rendering step: the window, or the offscreen one in headless mode
+GLuint sceneFBO = 0;
+// if true (--bench <scenario>), the camera follows the path of Scenarios/<scenario>.ini for a fixed number of frames,
+// and the frame times are written in a JSON report (--bench-output <file>, by default bench_<scenario>.json)
+bool benchmark = false;
+std::string benchScenarioName, benchOutput;
+SnowGL::BenchScenario benchScenario;
+// the passes timed on the GPU: the timestamp queries are read a few frames later, without waiting for the GPU
+enum gpu_passes{ SHADOW_PASS, SCENE_PASS, PARTICLE_UPDATE_PASS, PARTICLE_RENDER_PASS, GPU_PASS_COUNT };
+const char* gpuPassNames[GPU_PASS_COUNT] = { "shadow", "scene", "particle_update", "particle_render" };
+SnowGL::GpuTimer gpuTimer;
+// the uniform buffer of the values shared by the scene and particle programs, written once per frame
+SnowGL::FrameUniformBuffer frameUniforms;
+// if true (--gpu-times), the average GPU time of each pass is printed every GPU_LOG_PERIOD seconds
+bool logGpuTimes = false;
+#define GPU_LOG_PERIOD 2.0
+// draw calls and compute dispatches of the current frame
+unsigned int frameDrawCalls = 0, frameDispatches = 0;
+// if not empty (--profile <file>), the zones of the CPU profiler are recorded, and written as a Chrome trace at exit
+std::string profileOutput;
+void WriteProfile();
+// it takes the GPU times collected by gpuTimer, and adds those of the recorded frames to the benchmark report
+void CollectGpuTimes(SnowGL::BenchReport &report);
+// it prints the average GPU time of each pass
+void PrintGpuTimes();
+// the uniforms of the particle programs, hashed at compile time: setUniform finds them without building a string
+namespace ParticleUniform
+{
+    constexpr GLSLUniform Time("Time"), H("H"), Interp("Interp"), Accel("Accel"), EmitPeriod("EmitPeriod");
+    constexpr GLSLUniform DomainMin("DomainMin"), DomainSize("DomainSize"), Count("Count"), ParticleTex("ParticleTex");
+}
+// buffers, vertex arrays and feedback objects of the two ping-pong sets of particles
+SnowGL::ParticlePool particlePool;
 GLuint drawBuf, query;
 
 GLSLProgram prog;
 GLuint renderSub, updateSub;
+// compute backend: it updates the particle buffers in place
+GLSLProgram computeProg;
 
 int nParticles;
 
-float angle;
+// fixed timestep clock of the particle simulation: the update pass runs a constant number of times per
+// simulated second, whatever the frame rate. After a hitch, at most 5 steps are simulated in a frame.
+SnowGL::SimulationClock particleClock(1.0f/60.0f, 5);
+
+// emission rate and lifetime range of the particles, loaded from the settings file
+#define PARTICLE_SETTINGS_FILE "particles.ini"
+SnowGL::ParticleSettings particleSettings;
+// the settings file is watched: the changes are applied at the beginning of the next frame
+SnowGL::FileWatcher particleSettingsWatcher(PARTICLE_SETTINGS_FILE);
+// it counts the particles emitted so far: only the slots already used by a particle are updated and drawn
+SnowGL::ParticleEmitter particleEmitter(particleSettings);
 
-glm::mat4 model, projection;
+// seed of the random values of the particles
+#define PARTICLE_SEED 161
+// counter-based generator: the values of a particle slot depend only on the seed and its index
+SnowGL::ParticleRandom particleRandom(PARTICLE_SEED);
+// worker threads for the CPU side of the particle setup
+SnowGL::JobPool jobs;
+
+glm::mat4 projection;
 
 /////////////////// MAIN function ///////////////////////
-int main()
+int main(int argc, char **argv)
 {
-    
-    // Initialization of OpenGL context using GLFW
-    glfwInit();
-    // We set OpenGL specifications required for this application
-    // In this case: 4.1 Core
-    // If not supported by your graphics HW, the context will not be created and the application will close
-    // N.B.) creating GLAD code to load extensions, try to take into account the specifications and any extensions you want to use,
-    // in relation also to the values indicated in these GLFW commands
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 1);
-    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
-    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
-    // we set if the window is resizable
-    glfwWindowHint(GLFW_RESIZABLE, GL_FALSE);
-
-    // we create the application's window
-    GLFWwindow* window = glfwCreateWindow(screenWidth, screenHeight, "RGP_lecture05a", nullptr, nullptr);
-    if (!window)
+    // we parse the command line options
+    for (int i = 1; i < argc; i++)
     {
-        std::cout << "Failed to create GLFW window" << std::endl;
-        glfwTerminate();
-        return -1;
+        if (strcmp(argv[i], "--packed") == 0)
+            packedParticles = true;
+        else if (strcmp(argv[i], "--interleaved") == 0)
+            interleavedParticles = true;
+        else if (strcmp(argv[i], "--layout-bench") == 0)
+            layoutBenchmark = true;
+        else if (strcmp(argv[i], "--headless") == 0)
+            headless = true;
+        else if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc)
+            headlessFrames = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--bench") == 0 && i + 1 < argc) {
+            benchmark = true;
+            benchScenarioName = argv[++i];
+        }
+        else if (strcmp(argv[i], "--bench-output") == 0 && i + 1 < argc)
+            benchOutput = argv[++i];
+        else if (strcmp(argv[i], "--gpu-times") == 0)
+            logGpuTimes = true;
+        else if (strcmp(argv[i], "--forest") == 0 && i + 1 < argc)
+            forestTrees = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--cascades") == 0 && i + 1 < argc)
+            cascadeCount = glm::clamp(atoi(argv[++i]), 1, SnowGL::ShadowCascades::MAX_CASCADES);
+        else if (strcmp(argv[i], "--cascade-period") == 0 && i + 1 < argc)
+            cascadeUpdatePeriod = glm::max(atoi(argv[++i]), 1);
+        else if (strcmp(argv[i], "--shadow-kernel") == 0 && i + 1 < argc)
+            shadowKernelOption = argv[++i];
+        else if (strcmp(argv[i], "--profile") == 0 && i + 1 < argc)
+            profileOutput = argv[++i];
+        else if (strcmp(argv[i], "--backend") == 0 && i + 1 < argc) {
+            i++;
+            if (strcmp(argv[i], "feedback") == 0)
+                particleBackend = FEEDBACK_BACKEND;
+            else if (strcmp(argv[i], "compute") == 0)
+                particleBackend = COMPUTE_BACKEND;
+            else
+                std::cout << "Unknown backend: " << argv[i] << std::endl;
+        }
+        else
+            std::cout << "Unknown option: " << argv[i] << std::endl;
     }
-    glfwMakeContextCurrent(window);
-    cout << "-----init window----"<< endl;
-    // we put in relation the window and the callbacks
-    glfwSetKeyCallback(window, key_callback);
-    glfwSetCursorPosCallback(window, mouse_callback);
 
-    // we disable the mouse cursor
-    glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+    if (!profileOutput.empty())
+    {
+#ifdef SNOWGL_NO_PROFILER
+        std::cout << "The profiler is not available in this build" << std::endl;
+#endif
+        SnowGL::Profiler::setThreadName("main");
+        SnowGL::Profiler::setEnabled(true);
+    }
+
+    // in the benchmark mode, we load the scenario before creating the context, so an error is reported at once
+    if (benchmark)
+    {
+        if (!benchScenario.fromScenarioFile("Scenarios/" + benchScenarioName + ".ini"))
+            return -1;
+        if (benchOutput.empty())
+            benchOutput = "bench_" + benchScenarioName + ".json";
+    }
 
-    // GLAD tries to load the context set by GLFW
-    if (!gladLoadGLLoader((GLADloadproc) glfwGetProcAddress))
+    // we start the application clock
+    GetTime();
+    GLFWwindow* window = nullptr;
+    bool loaded = false;
+#ifdef RAINSNOW_HEADLESS
+    SnowGL::HeadlessContext headlessContext;
+#endif
+    if (headless)
+    {
+        SNOWGL_PROFILE_SCOPE("CreateContext");
+#ifdef RAINSNOW_HEADLESS
+        // no window and no input: an EGL context without surface, 4.3 Core for the compute backend, otherwise 4.1 Core
+        bool created = particleBackend == COMPUTE_BACKEND && headlessContext.create(4, 3);
+        if (!created && particleBackend == COMPUTE_BACKEND)
+        {
+            std::cout << "OpenGL 4.3 not available: particles are updated with transform feedback" << std::endl;
+            particleBackend = FEEDBACK_BACKEND;
+        }
+        if (!created && !headlessContext.create(4, 1))
+        {
+            std::cout << "Failed to create EGL context" << std::endl;
+            return -1;
+        }
+        cout << "-----init headless context----"<< endl;
+        loaded = gladLoadGLLoader((GLADloadproc) SnowGL::HeadlessContext::getProcAddress);
+#else
+        std::cout << "Headless mode not available in this build (make headless)" << std::endl;
+        return -1;
+#endif
+    }
+    else
+    {
+        SNOWGL_PROFILE_SCOPE("CreateContext");
+        // Initialization of OpenGL context using GLFW
+        glfwInit();
+        // We set OpenGL specifications required for this application
+        // In this case: 4.3 Core for the compute backend, otherwise 4.1 Core
+        // If not supported by your graphics HW, the context will not be created and the application will close
+        // N.B.) creating GLAD code to load extensions, try to take into account the specifications and any extensions you want to use,
+        // in relation also to the values indicated in these GLFW commands
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, particleBackend == COMPUTE_BACKEND ? 3 : 1);
+        glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+        glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+        // we set if the window is resizable
+        glfwWindowHint(GLFW_RESIZABLE, GL_FALSE);
+
+        // we create the application's window
+        window = glfwCreateWindow(screenWidth, screenHeight, "RGP_lecture05a", nullptr, nullptr);
+        if (!window && particleBackend == COMPUTE_BACKEND)
+        {
+            // OpenGL 4.3 is not available (e.g., on MacOS): we fall back to 4.1 and to transform feedback
+            std::cout << "OpenGL 4.3 not available: particles are updated with transform feedback" << std::endl;
+            particleBackend = FEEDBACK_BACKEND;
+            glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 1);
+            window = glfwCreateWindow(screenWidth, screenHeight, "RGP_lecture05a", nullptr, nullptr);
+        }
+        if (!window)
+        {
+            std::cout << "Failed to create GLFW window" << std::endl;
+            glfwTerminate();
+            return -1;
+        }
+        glfwMakeContextCurrent(window);
+        cout << "-----init window----"<< endl;
+        // we put in relation the window and the callbacks (in the benchmark mode, the mouse does not move the camera)
+        glfwSetKeyCallback(window, key_callback);
+        if (!benchmark)
+            glfwSetCursorPosCallback(window, mouse_callback);
+        // in the benchmark mode, the frame rate is not limited by the vertical sync
+        if (benchmark)
+            glfwSwapInterval(0);
+
+        // we disable the mouse cursor
+        glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+
+        // GLAD tries to load the context set by GLFW
+        loaded = gladLoadGLLoader((GLADloadproc) glfwGetProcAddress);
+    }
+
+    // we check that GLAD loaded the OpenGL functions
+    if (!loaded)
     {
         std::cout << "Failed to initialize OpenGL context" << std::endl;
         return -1;
     }
 
     // we define the viewport dimensions
-    int width, height;
-    glfwGetFramebufferSize(window, &width, &height);
+    int width = screenWidth, height = screenHeight;
+    if (!headless)
+        glfwGetFramebufferSize(window, &width, &height);
+
+    // in headless mode, the final rendering step is done in a framebuffer object with color and depth renderbuffers
+    GLuint sceneRenderbuffers[2];
+    if (headless)
+    {
+        glGenRenderbuffers(2, sceneRenderbuffers);
+        glBindRenderbuffer(GL_RENDERBUFFER, sceneRenderbuffers[0]);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+        glBindRenderbuffer(GL_RENDERBUFFER, sceneRenderbuffers[1]);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+        glGenFramebuffers(1, &sceneFBO);
+        glBindFramebuffer(GL_FRAMEBUFFER, sceneFBO);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, sceneRenderbuffers[0]);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, sceneRenderbuffers[1]);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+        {
+            std::cout << "Offscreen framebuffer is not complete" << std::endl;
+            return -1;
+        }
+        glViewport(0, 0, width, height);
+    }
     
 
     // we enable Z test
@@ -271,22 +613,55 @@ int main()
 
     //the "clear" color for the frame buffer
     glClearColor(0.26f, 0.46f, 0.98f, 1.0f);
+    // the programs read the per-frame values from this buffer (their blocks are attached after the link)
+    frameUniforms.create();
+    // at worst, all the objects are inside the view and the light frustum of every cascade in the same frame
+    transformRing.create((SCENE_PROPS + glm::max(forestTrees, 0)) * (1 + cascadeCount));
+    // the compute backend updates the particles in place: only the ping-pong streams of transform feedback are interleaved
+    if (interleavedParticles && particleBackend == COMPUTE_BACKEND)
+    {
+        std::cout << "WARNING: --interleaved is ignored with the compute backend (use --backend feedback)" << std::endl;
+        interleavedParticles = false;
+    }
     cout << "-----compiling shader----"<< endl;
-    CompileAndLinkShader();
+    CompileAndLinkShader(prog);
+    if (particleBackend == COMPUTE_BACKEND)
+        CompileComputeShader(computeProg);
 
 
     cout << "-----shader compiled----"<< endl;
     GLuint programHandle = prog.getHandle();
     renderSub = glGetSubroutineIndex(programHandle, GL_VERTEX_SHADER, "render");
     updateSub = glGetSubroutineIndex(programHandle, GL_VERTEX_SHADER, "update");
+    // each buffer slot emits a particle every getMaxParticles()/particlesPerSecond seconds
+    // the values below are used only if the settings file cannot be loaded
+    particleSettings.particlesPerSecond = 1000;
+    particleSettings.lifetimeMin = 2.5f;
+    particleSettings.lifetimeMax = 3.5f;
+    // in the benchmark mode, the settings are those of the scenario, and they are not reloaded when the file changes
+    SnowGL::ParticleSettings defaultSettings = particleSettings;
+    particleSettings.fromSettingsFile(benchmark ? benchScenario.settingsFile : std::string(PARTICLE_SETTINGS_FILE));
+    if (!particleSettings.isValid())
+    {
+        std::cout << "ERROR::PARTICLESETTINGS:: invalid emission rate or lifetime range, the default settings are used" << std::endl;
+        particleSettings = defaultSettings;
+    }
+
+    if (layoutBenchmark) {
+        RunLayoutBenchmark();
+        WriteProfile();
+        frameUniforms.destroy();
+        transformRing.destroy();
+        if (!headless)
+            glfwTerminate();
+        return 0;
+    }
     glPointSize(10.0f);
     glEnable(GL_BLEND);
     glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
-    model = glm::mat4(1.0f);
-
-    initBuffers();
-    cout << "-----buffers initiated----"<< endl;
+    initBuffers(particleSettings.getMaxParticles());
+    cout << "-----buffers initiated: " << particlePool.getUsedBytes() << " bytes used of " << particlePool.getReservedBytes() << " reserved----"<< endl;
 
 
     // we create the Shader Program used for objects (which presents different subroutines we can switch)
@@ -296,6 +671,26 @@ int main()
     // we parse the Shader Program to search for the number and names of the subroutines.
     // the names are placed in the shaders vector
     SetupShader(illumination_shader.Program, false);
+    // we select the shadow kernel requested on the command line
+    if (shadowKernelOption == "all")
+        cycleShadowKernels = true;
+    else if (!shadowKernelOption.empty())
+    {
+        vector<std::string>::iterator kernel = std::find(shaders.begin(), shaders.end(), shadowKernelOption);
+        if (kernel != shaders.end())
+            current_subroutine = (GLuint)(kernel - shaders.begin());
+        else
+            std::cout << "Unknown shadow kernel: " << shadowKernelOption << std::endl;
+    }
+    ResolveIlluminationUniforms(illumination_shader);
+    SnowGL::FrameUniformBuffer::attach(illumination_shader.Program);
+    illuminationProgram = renderList.addProgram(illumination_shader.Program, illuminationUniforms.objectIndex.location,
+                                                illuminationUniforms.tex.location, illuminationUniforms.repeat.location);
+    // we create the Shader Program for the creation of the shadow map
+    Shader shadow_shader = Shader("19_shadowmap.vert", "20_shadowmap.frag");
+    ResolveShadowUniforms(shadow_shader);
+    // the shadow map has no material: only the depth is written
+    shadowProgram = renderList.addProgram(shadow_shader.Program, shadowUniforms.objectIndex.location, -1, -1);
     // we print on console the name of the first subroutine used
     PrintCurrentShader(current_subroutine);
 cout << "-----loading textures----"<< endl;
@@ -307,9 +702,10 @@ cout << "-----loading textures----"<< endl;
     // textureID.push_back(LoadTexture("../../textures/DB2X2_L01_Nor.png"));
     // textureID.push_back(LoadTexture("../../textures/DB2X2_L01.png"));
 cout << "-----texture loaded----"<< endl;
-    prog.setUniform("ParticleTex", 0);
-    prog.setUniform("ParticleLifetime", 3.5f);
-    prog.setUniform("Accel", glm::vec3(0.0f,-0.4f,0.0f));
+    prog.setUniform(ParticleUniform::ParticleTex, 0);
+    SetParticleUniforms(prog);
+    if (particleBackend == COMPUTE_BACKEND)
+        SetParticleUniforms(computeProg);
 
     // we load the model(s) (code of Model class is in include/utils/model_v2.h)
     Model benchModel("../../models/bench.obj");
@@ -318,41 +714,51 @@ cout << "-----texture loaded----"<< endl;
     Model planeModel("../../models/plane.obj");
     cout << "-----models loaded----"<< endl;
 
+    // we create the materials and place the objects in the scene
+    int groundMaterial = renderList.addMaterial(textureID[1], 80.0f);
+    int gridMaterial = renderList.addMaterial(textureID[0], repeat);
+    int barkMaterial = renderList.addMaterial(textureID[2], repeat);
+    AddProp(planeModel, groundMaterial, glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(10.0f, 1.0f, 10.0f), false);
+    AddProp(lampModel, gridMaterial, glm::vec3(-3.0f, -1.0f, 3.0f), glm::vec3(0.25f), true);
+    AddProp(benchModel, gridMaterial, glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(0.01f), true);
+    AddProp(treeModel, barkMaterial, glm::vec3(5.0f, -1.0f, 5.0f), glm::vec3(1.5f), true);
+    // the ring is sized for the forest, unless it hits GL_MAX_TEXTURE_BUFFER_SIZE: then the forest is reduced to the copies
+    // which fit, instead of failing the allocation of its transforms
+    int maxForestTrees = transformRing.getCapacity() / (1 + cascadeCount) - (int)props.size();
+    if (forestTrees > maxForestTrees)
+    {
+        std::cout << "WARNING: GL_MAX_TEXTURE_BUFFER_SIZE limits the transform ring to " << transformRing.getCapacity()
+                  << " objects per frame, the forest is reduced from " << forestTrees << " to " << glm::max(maxForestTrees, 0) << " trees" << std::endl;
+        forestTrees = glm::max(maxForestTrees, 0);
+    }
+    if (forestTrees > 0)
+    {
+        // the trees are placed with random position, orientation and size, the same at each run
+        SnowGL::ParticleRandom forestRandom(FOREST_SEED);
+        vector<glm::mat4> forest(forestTrees);
+        for (int i = 0; i < forestTrees; i++)
+        {
+            float values[4];
+            forestRandom.uniform((uint32_t)i, 0, values);
+            forest[i] = glm::translate(glm::mat4(1.0f), glm::vec3(90.0f * values[0] - 45.0f, -1.0f, 90.0f * values[1] - 45.0f));
+            forest[i] = glm::rotate(forest[i], glm::radians(360.0f * values[2]), glm::vec3(0.0f, 1.0f, 0.0f));
+            forest[i] = glm::scale(forest[i], glm::vec3(1.0f + values[3]));
+        }
+        AddPropInstances(treeModel, barkMaterial, forest);
+    }
+    BuildSceneBVH();
+
 
     /////////////////// CREATION OF BUFFER FOR THE  DEPTH MAP /////////////////////////////////////////
     // buffer dimension: too large -> performance may slow down if we have many lights; too small -> strong aliasing
     const GLuint SHADOW_WIDTH = 1024, SHADOW_HEIGHT = 1024;
-    GLuint depthMapFBO;
-    // we create a Frame Buffer Object: the first rendering step will render to this buffer, and not to the real frame buffer
-    glGenFramebuffers(1, &depthMapFBO);
-    // we create a texture for the depth map
-    GLuint depthMap;
-    glGenTextures(1, &depthMap);
-    glBindTexture(GL_TEXTURE_2D, depthMap);
-    // in the texture, we will save only the depth data of the fragments. Thus, we specify that we need to render only depth in the first rendering step
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT, SHADOW_WIDTH, SHADOW_HEIGHT, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-    // we set to clamp the uv coordinates outside [0,1] to the color of the border
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
-
-
-
-
-    // outside the area covered by the light frustum, everything is rendered in shadow (because we set GL_CLAMP_TO_BORDER)
-    // thus, we set the texture border to white, so to render correctly everything not involved by the shadow map
-    //*************
-    GLfloat borderColor[] = { 1.0f, 1.0f, 1.0f, 1.0f };
-    glTexParameterfv(GL_TEXTURE_2D, GL_TEXTURE_BORDER_COLOR, borderColor);
-
-    // we bind the depth map FBO
-    glBindFramebuffer(GL_FRAMEBUFFER, depthMapFBO);
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, depthMap, 0);
-    // we set that we are not calculating nor saving color data
-    glDrawBuffer(GL_NONE);
-    glReadBuffer(GL_NONE);
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    // the shadow maps and the cache of the static casters: two depth texture arrays with a layer for each cascade, and
+    // a Frame Buffer Object for each layer, which we render to instead of the real frame buffer. Outside the area covered
+    // by the light frustum, everything is lit (the border of the textures is white, and the uv coordinates outside [0,1]
+    // are clamped to the border)
+    shadowCache.create(SHADOW_WIDTH, SHADOW_HEIGHT, cascadeCount);
+    shadowCascades.configure(cascadeCount, cascadeUpdatePeriod, SHADOW_WIDTH, SHADOW_DISTANCE);
+    glBindFramebuffer(GL_FRAMEBUFFER, sceneFBO);
     ///////////////////////////////////////////////////////////////////
 
 
@@ -361,32 +767,128 @@ cout << "-----texture loaded----"<< endl;
     
     int drawBuf = 0;
 
+    // the number of frames to run: -1 until the window is closed
+    int runFrames = -1;
+    if (benchmark)
+        runFrames = benchScenario.warmupFrames + benchScenario.frames;
+    else if (headless)
+        runFrames = headlessFrames;
+    SnowGL::BenchReport benchReport;
+    gpuTimer.create(GPU_PASS_COUNT);
+    double lastGpuLog = 0.0;
+
     cout << "starting loop ------------"<< endl;
+    int frame = 0;
+    double loopStart = GetTime();
     // Rendering loop: this code is executed at each frame
-    while(!glfwWindowShouldClose(window))
+    while(!(window && glfwWindowShouldClose(window)) && (runFrames < 0 || frame < runFrames))
     {
+        SNOWGL_PROFILE_SCOPE("Frame");
         // we determine the time passed from the beginning
         // and we calculate time difference between current frame rendering and the previous one
-        GLfloat currentFrame = glfwGetTime();
+        double frameStart = GetTime();
+        GLfloat currentFrame = frameStart;
         deltaTime = currentFrame - lastFrame;
         lastFrame = currentFrame;
+        // in headless and benchmark modes each frame simulates one fixed step, so a run gives the same frames at any speed
+        if (headless || benchmark)
+            deltaTime = particleClock.getFixedStep();
+        frameDrawCalls = frameDispatches = 0;
+        gpuTimer.beginFrame();
 
         // Check is an I/O event is happening
-        glfwPollEvents();
-        // we apply FPS camera movements
-        apply_camera_movements();
+        if (!headless)
+        {
+            SNOWGL_PROFILE_SCOPE("PollEvents");
+            glfwPollEvents();
+        }
+        if (benchmark)
+        {
+            SNOWGL_PROFILE_SCOPE("Camera");
+            // the camera follows the path of the scenario, which starts after the warmup frames
+            float pathTime = glm::max(frame - benchScenario.warmupFrames, 0) * particleClock.getFixedStep();
+            SnowGL::BenchScenario::CameraKey cameraKey = benchScenario.cameraAt(pathTime);
+            camera.SetPose(cameraKey.position, cameraKey.yaw, cameraKey.pitch);
+        }
+        else
+        {
+            // if the settings file has been saved, we apply it before rendering the frame
+            if (particleSettingsWatcher.hasChanged())
+                reloadParticleSettings();
+            // we apply FPS camera movements
+            apply_camera_movements();
+        }
 
    
 
    
 
-        /////////////////// STEP 2 - SCENE RENDERING FROM CAMERA ////////////////////////////////////////////////
-
         // we get the view matrix from the Camera class
         view = camera.GetViewMatrix();
 
-        // we activate back the standard Frame Buffer
-        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        bool cascadeDue[SnowGL::ShadowCascades::MAX_CASCADES], cascadeStatic[SnowGL::ShadowCascades::MAX_CASCADES];
+        {
+            SNOWGL_PROFILE_SCOPE("SceneUniforms");
+            // we write projection and view matrices, and the parameters of the illumination model, in the uniform buffer
+            // read by both the illumination shader and the particles
+            SnowGL::FrameUniformData frameData;
+            frameData.projectionMatrix = projection;
+            frameData.viewMatrix = view;
+            frameData.lightVector = lightDir0;
+            frameData.Kd = Kd;
+            frameData.alpha = alpha;
+            frameData.F0 = F0;
+            frameUniforms.update(frameData);
+
+            // we write the transforms of the objects in the segment of the frame, skipping the copies outside the view
+            culler.setViewProjection(projection * view);
+            culler.resetStats();
+            transformRing.beginFrame();
+            UpdateObjectTransforms();
+            // and those of the shadow casters of the cascades rendered in this frame, fitted to the camera: the static
+            // ones only if the cache of the cascade must be rendered
+            shadowCascades.fit(projection, view, lightDir0, shadowBounds);
+            for (int c = 0; c < cascadeCount; c++)
+            {
+                cascadeDue[c] = shadowCascades.isDue(c, frame);
+                cascadeStatic[c] = cascadeDue[c] && shadowCache.needsStaticUpdate(c, shadowCascades.getFitted(c));
+                if (cascadeDue[c])
+                    UpdateShadowCasterTransforms(c, cascadeStatic[c]);
+            }
+            transformRing.flush();
+        }
+
+        /////////////////// STEP 1 - SHADOW MAP: RENDERING OF SCENE FROM LIGHT POINT OF VIEW ////////////////////////////////////////////////
+
+        gpuTimer.begin(SHADOW_PASS);
+        // we render the depth of the scene from the point of view of the light (always with filled polygons)
+        glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+        shadow_shader.Use();
+        frameShadowCasters = frameCascadeUpdates = 0;
+        for (int c = 0; c < cascadeCount; c++)
+        {
+            if (!cascadeDue[c])
+                continue;
+            shadow_shader.Set(shadowUniforms.lightSpaceMatrix, shadowCascades.getFitted(c));
+            if (cascadeStatic[c])
+            {
+                shadowCache.beginStatic(c);
+                RenderShadowCasters(shadow_shader, c, true);
+                shadowCache.endStatic(c);
+            }
+            // the static depth is copied in the shadow map, and the objects which spin are rendered on top of it
+            shadowCache.beginDynamic(c);
+            RenderShadowCasters(shadow_shader, c, false);
+            // the cascade is sampled with the matrix it has been rendered with, until its next update
+            shadowCascades.markRendered(c);
+            frameCascadeUpdates++;
+        }
+        gpuTimer.end(SHADOW_PASS);
+
+        /////////////////// STEP 2 - SCENE RENDERING FROM CAMERA ////////////////////////////////////////////////
+
+        // we activate back the standard Frame Buffer (or the offscreen one)
+        glBindFramebuffer(GL_FRAMEBUFFER, sceneFBO);
 
         // we "clear" the frame and z buffer
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
@@ -408,162 +910,387 @@ cout << "-----texture loaded----"<< endl;
 
             // ILLUMINATION SHADER //
 
+        gpuTimer.begin(SCENE_PASS);
         // We "install" the selected Shader Program as part of the current rendering process. We pass to the shader the light transformation matrix, and the depth map rendered in the first rendering step
         illumination_shader.Use();
-         // we search inside the Shader Program the name of the subroutine currently selected, and we get the numerical index
-        GLuint index = glGetSubroutineIndex(illumination_shader.Program, GL_FRAGMENT_SHADER, shaders[current_subroutine].c_str());
-        // we activate the subroutine using the index (this is where shaders swapping happens)
-        glUniformSubroutinesuiv( GL_FRAGMENT_SHADER, 1, &index);
-
-        // we pass projection and view matrices to the Shader Program
-        glUniformMatrix4fv(glGetUniformLocation(illumination_shader.Program, "projectionMatrix"), 1, GL_FALSE, glm::value_ptr(projection));
-        glUniformMatrix4fv(glGetUniformLocation(illumination_shader.Program, "viewMatrix"), 1, GL_FALSE, glm::value_ptr(view));
-        //glUniformMatrix4fv(glGetUniformLocation(illumination_shader.Program, "lightSpaceMatrix"), 1, GL_FALSE, glm::value_ptr(lightSpaceMatrix));
-
-        // we determine the position in the Shader Program of the uniform variables
-        GLint lightDirLocation = glGetUniformLocation(illumination_shader.Program, "lightVector");
-        GLint kdLocation = glGetUniformLocation(illumination_shader.Program, "Kd");
-        GLint alphaLocation = glGetUniformLocation(illumination_shader.Program, "alpha");
-        GLint f0Location = glGetUniformLocation(illumination_shader.Program, "F0");
-
-        // we assign the value to the uniform variables
-        glUniform3fv(lightDirLocation, 1, glm::value_ptr(lightDir0));
-        glUniform1f(kdLocation, Kd);
-        glUniform1f(alphaLocation, alpha);
-        glUniform1f(f0Location, F0);
+        // we activate the subroutine currently selected, using the index resolved in SetupShader (this is where shaders swapping happens).
+        // glUseProgram resets the subroutines, so the render list sets them each time it binds the program
+        if (cycleShadowKernels)
+            current_subroutine = frame % shaders.size();
+        renderList.setFragmentSubroutines(illuminationProgram, &shaderIndices[current_subroutine], 1);
+        frameShadowKernels[frame % (SnowGL::GpuTimer::FRAMES + 1)] = current_subroutine;
+        illumination_shader.Set(illuminationUniforms.cascadeMatrices, shadowCascades.getMatrices(), cascadeCount);
+        illumination_shader.Set(illuminationUniforms.cascadeSplits, shadowCascades.getSplits(), cascadeCount);
+        illumination_shader.Set(illuminationUniforms.cascadeTexelSizes, shadowCascades.getTexelSizes(), cascadeCount);
+        illumination_shader.Set(illuminationUniforms.cascadeDepthRanges, shadowCascades.getDepthRanges(), cascadeCount);
+        illumination_shader.Set(illuminationUniforms.cascadeCount, cascadeCount);
 
         // we render the scene
-        RenderObjects(illumination_shader, planeModel, benchModel, lampModel, treeModel, RENDER, depthMap);
+        RenderObjects(illumination_shader, RENDER, shadowCache.getDepthMap());
+        frameDrawCalls += renderList.getStats().draws;
+        gpuTimer.end(SCENE_PASS);
 
-        // Swapping back and front buffers
-        glfwSwapBuffers(window);
+        // we update and render the particles
+        renderParticles();
+        // the segment of the transforms can be written again when the GPU has completed the frame
+        transformRing.endFrame();
 
+        // Swapping back and front buffers (in headless mode, we wait for the frame to be completed)
+        {
+            SNOWGL_PROFILE_SCOPE("Swap");
+            if (headless)
+                glFinish();
+            else
+                glfwSwapBuffers(window);
+        }
 
+        // in the benchmark mode, we record the frame. The GPU times arrive a few frames later
+        if (benchmark && frame >= benchScenario.warmupFrames)
+        {
+            benchReport.addSample("cpu_frame_ms", 1000.0 * (GetTime() - frameStart));
+            benchReport.addSample("draw_calls", frameDrawCalls);
+            benchReport.addSample("instances", renderList.getStats().instances);
+            benchReport.addSample("state_changes", renderList.getStats().programChanges + renderList.getStats().materialChanges + renderList.getStats().vaoChanges);
+            benchReport.addSample("meshes_drawn", frameMeshesDrawn);
+            benchReport.addSample("meshes_culled", frameMeshesCulled);
+            benchReport.addSample("bvh_nodes_visited", frameBVHNodes);
+            benchReport.addSample("shadow_casters", frameShadowCasters);
+            benchReport.addSample("cascade_updates", frameCascadeUpdates);
+            benchReport.addSample("dispatches", frameDispatches);
+            benchReport.addSample("live_particles", (double)glm::min(particleEmitter.getEmittedCount(), (size_t)nParticles));
+        }
+        CollectGpuTimes(benchReport);
+        if (logGpuTimes && frameStart - lastGpuLog >= GPU_LOG_PERIOD)
+        {
+            PrintGpuTimes();
+            lastGpuLog = frameStart;
+        }
+        frame++;
+    }
+    // we wait for the GPU times of the last frames
+    gpuTimer.finish();
+    CollectGpuTimes(benchReport);
 
+    // in headless mode, the exit status reports if an OpenGL error happened during the run
+    int status = EXIT_SUCCESS;
+    if (benchmark)
+    {
+        benchReport.setInfo("scenario", benchScenarioName);
+        benchReport.setInfo("renderer", (const char*)glGetString(GL_RENDERER));
+        benchReport.setInfo("version", (const char*)glGetString(GL_VERSION));
+        benchReport.setInfo("backend", particleBackend == COMPUTE_BACKEND ? "compute" : "feedback");
+        benchReport.setInfo("layout", std::string(packedParticles ? "packed" : "float") + (interleavedParticles ? " interleaved" : " separate"));
+        benchReport.setInfo("headless", headless ? 1.0 : 0.0);
+        benchReport.setInfo("width", width);
+        benchReport.setInfo("height", height);
+        benchReport.setInfo("frames", frame - benchScenario.warmupFrames);
+        benchReport.setInfo("warmup_frames", benchScenario.warmupFrames);
+        benchReport.setInfo("particle_capacity", nParticles);
+        benchReport.setInfo("forest_trees", forestTrees);
+        benchReport.setInfo("bvh_nodes", (double)sceneBVH.getNodeCount());
+        benchReport.setInfo("shadow_static_updates", (double)shadowCache.getStaticUpdates());
+        benchReport.setInfo("cascades", cascadeCount);
+        benchReport.setInfo("cascade_update_period", cascadeUpdatePeriod);
+        benchReport.setInfo("shadow_kernel", cycleShadowKernels ? std::string("all") : shaders[current_subroutine]);
+        benchReport.setInfo("particle_bytes", (double)particlePool.getUsedBytes());
+        benchReport.setInfo("gpu_dropped_frames", (double)gpuTimer.getDroppedFrames());
+        benchReport.setInfo("transform_ring_persistent", transformRing.isPersistent() ? 1.0 : 0.0);
+        benchReport.setInfo("transform_ring_waits", (double)transformRing.getWaits());
+        if (benchReport.writeJson(benchOutput))
+            cout << "benchmark report written in " << benchOutput << endl;
+        else
+        {
+            cout << "Unable to write " << benchOutput << endl;
+            status = EXIT_FAILURE;
+        }
+    }
+    // the queries and buffers are deleted while the context still exists
+    gpuTimer.destroy();
+    frameUniforms.destroy();
+    transformRing.destroy();
+    shadowCache.destroy();
+    WriteProfile();
+    if (headless)
+    {
+        double elapsed = GetTime() - loopStart;
+        cout << frame << " frames in " << elapsed << " s (" << (frame > 0 ? 1000.0 * elapsed / frame : 0.0) << " ms per frame)" << endl;
+        PrintGpuTimes();
+        GLenum error = glGetError();
+        if (error != GL_NO_ERROR)
+        {
+            cout << "OpenGL error 0x" << std::hex << error << std::dec << endl;
+            status = EXIT_FAILURE;
+        }
+        glDeleteFramebuffers(1, &sceneFBO);
+        glDeleteRenderbuffers(2, sceneRenderbuffers);
     }
 
     // when I exit from the graphics loop, it is because the application is closing
     // we delete the Shader Programs
     illumination_shader.Delete();
     // chiudo e cancello il contesto creato
-    glfwTerminate();
-    return 0;
+    if (!headless)
+        glfwTerminate();
+    return status;
 }
 
 
 //////////////////////////////////////////
-// we render the objects. We pass also the current rendering step, and the depth map generated in the first step, which is used by the shaders of the second step
-void RenderObjects(Shader &shader, Model &planeModel, Model &benchModel, Model &lampModel, Model &treeModel, GLint render_pass, GLuint depthMap)
+// we add an object to the scene: it is drawn from the next frame
+void AddProp(Model &model, int material, glm::vec3 position, glm::vec3 scale, bool spins)
 {
-    // For the second rendering step -> we pass the shadow map to the shaders
-    if (render_pass==RENDER)
+    Prop prop;
+    prop.model = &model;
+    prop.material = material;
+    prop.position = position;
+    prop.scale = scale;
+    prop.spins = spins;
+    prop.modelMatrix = glm::mat4(1.0f);
+    prop.firstPrimitive = 0;
+    prop.object = -1;
+    prop.visibleInstances = 0;
+    for (int c = 0; c < SnowGL::ShadowCascades::MAX_CASCADES; c++)
     {
-        glActiveTexture(GL_TEXTURE2);
-        glBindTexture(GL_TEXTURE_2D, depthMap);
-        GLint shadowLocation = glGetUniformLocation(shader.Program, "shadowMap");
-        glUniform1i(shadowLocation, 2);
+        prop.shadowObject[c] = -1;
+        prop.shadowInstances[c] = 0;
     }
-    // we pass the needed uniforms
-    GLint textureLocation = glGetUniformLocation(shader.Program, "tex");
-    GLint repeatLocation = glGetUniformLocation(shader.Program, "repeat");
+    props.push_back(prop);
+}
 
-    // PLANE
-    // we activate the texture of the plane
-    glActiveTexture(GL_TEXTURE1);
-    glBindTexture(GL_TEXTURE_2D, textureID[1]);
-    glUniform1i(textureLocation, 1);
-    glUniform1f(repeatLocation, 80.0);
+// we add the copies of a model to the scene: their transforms are computed once, and copied in the transform ring at each frame
+void AddPropInstances(Model &model, int material, const vector<glm::mat4> &modelMatrices)
+{
+    AddProp(model, material, glm::vec3(0.0f), glm::vec3(1.0f), false);
+    Prop &prop = props.back();
+    prop.instances.resize(modelMatrices.size());
+    for (size_t i = 0; i < modelMatrices.size(); i++)
+        prop.instances[i].set(modelMatrices[i]);
+}
 
+// the model matrix of an object without copies
+glm::mat4 PropModelMatrix(const Prop &prop)
+{
+    glm::mat4 modelMatrix = glm::translate(glm::mat4(1.0f), prop.position);
+    if (prop.spins)
+        modelMatrix = glm::rotate(modelMatrix, glm::radians(orientationY), glm::vec3(0.0f, 1.0f, 0.0f));
+    return glm::scale(modelMatrix, prop.scale);
+}
+
+// we build the hierarchy of the boxes of the objects: an object has a box, and the copies of an object have consecutive boxes
+void BuildSceneBVH()
+{
+    SNOWGL_PROFILE_SCOPE("BuildSceneBVH");
+    vector<SnowGL::AABB> bounds;
+    for (Prop &prop : props)
+    {
+        prop.firstPrimitive = (uint32_t)bounds.size();
+        if (prop.instances.empty())
+            bounds.push_back(prop.model->bounds.transformed(PropModelMatrix(prop)));
+        for (const SnowGL::ObjectTransform &instance : prop.instances)
+            bounds.push_back(prop.model->bounds.transformed(instance.modelMatrix));
+        // the light frustum must contain the objects in any orientation
+        if (prop.spins)
+        {
+            SnowGL::BoundingSphere sphere = prop.model->sphere.transformed(PropModelMatrix(prop));
+            shadowBounds.expand(sphere.center - sphere.radius);
+            shadowBounds.expand(sphere.center + sphere.radius);
+        }
+    }
+    for (const SnowGL::AABB &box : bounds)
+        shadowBounds.expand(box);
+    sceneBVH.build(bounds);
+}
+
+//////////////////////////////////////////
+// we compute the transforms of the objects, and write them in the segment of the frame of the transform ring
+void UpdateObjectTransforms()
+{
+    SNOWGL_PROFILE_SCOPE("ObjectTransforms");
     /*
       we create the transformation matrix
 
       N.B.) the last defined is the first applied
 
-      We need also the matrix for normals transformation, which is the inverse of the transpose of the 3x3 submatrix (upper left) of the modelview. We do not consider the 4th column because we do not need translations for normals.
+      We need also the matrix for normals transformation, which is the inverse of the transpose of the 3x3 submatrix (upper left) of the model matrix. We do not consider the 4th column because we do not need translations for normals. The normal matrix is computed by the ring in world coordinates: the shaders apply the view matrix, which has no scaling.
       An explanation (where XT means the transpose of X, etc):
         "Two column vectors X and Y are perpendicular if and only if XT.Y=0. If We're going to transform X by a matrix M, we need to transform Y by some matrix N so that (M.X)T.(N.Y)=0. Using the identity (A.B)T=BT.AT, this becomes (XT.MT).(N.Y)=0 => XT.(MT.N).Y=0. If MT.N is the identity matrix then this reduces to XT.Y=0. And MT.N is the identity matrix if and only if N=(MT)-1, i.e. N is the inverse of the transpose of M.
     */
-    // we reset to identity at each frame
-    planeModelMatrix = glm::mat4(1.0f);
-    planeNormalMatrix = glm::mat3(1.0f);
-    planeModelMatrix = glm::translate(planeModelMatrix, glm::vec3(0.0f, -1.0f, 0.0f));
-    planeModelMatrix = glm::scale(planeModelMatrix, glm::vec3(10.0f, 1.0f, 10.0f));
-    planeNormalMatrix = glm::inverseTranspose(glm::mat3(view*planeModelMatrix));
-    glUniformMatrix4fv(glGetUniformLocation(shader.Program, "modelMatrix"), 1, GL_FALSE, glm::value_ptr(planeModelMatrix));
-    glUniformMatrix3fv(glGetUniformLocation(shader.Program, "normalMatrix"), 1, GL_FALSE, glm::value_ptr(planeNormalMatrix));
-    // we render the plane
-    planeModel.Draw();
-
-    // lamp
-    // we activate the texture of the object
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, textureID[0]);
-    glUniform1i(textureLocation, 0);
-    glUniform1f(repeatLocation, repeat);
-
-    // we reset to identity at each frame
-    lampModelMatrix = glm::mat4(1.0f);
-    lampNormalMatrix = glm::mat3(1.0f);
-    lampModelMatrix = glm::translate(lampModelMatrix, glm::vec3(-3.0f, -1.0f, 3.0f));
-    lampModelMatrix = glm::rotate(lampModelMatrix, glm::radians(orientationY), glm::vec3(0.0f, 1.0f, 0.0f));
-    lampModelMatrix = glm::scale(lampModelMatrix, glm::vec3(0.25f, 0.25f, 0.25f));
-    lampNormalMatrix = glm::inverseTranspose(glm::mat3(view*lampModelMatrix));
-    glUniformMatrix4fv(glGetUniformLocation(shader.Program, "modelMatrix"), 1, GL_FALSE, glm::value_ptr(lampModelMatrix));
-    glUniformMatrix3fv(glGetUniformLocation(shader.Program, "normalMatrix"), 1, GL_FALSE, glm::value_ptr(lampNormalMatrix));
-
-    // we render the lamp
-    lampModel.Draw();
-    
+    for (Prop &prop : props)
+    {
+        if (!prop.instances.empty())
+            continue;
+        prop.modelMatrix = PropModelMatrix(prop);
+        // the box of an object which spins changes: the tree is refitted before the query
+        if (prop.spins)
+            sceneBVH.setBounds(prop.firstPrimitive, prop.model->bounds.transformed(prop.modelMatrix));
+    }
+    sceneBVH.refit();
+
+    // the boxes inside the view frustum, sorted by id
+    static vector<uint32_t> visible;
+    sceneBVH.queryFrustum(culler, visible);
+    frameBVHNodes = sceneBVH.getStats().nodes;
+    std::sort(visible.begin(), visible.end());
+    WriteVisibleTransforms(visible, -1);
+}
 
-    // bench
+// the boxes of an object (of its copies) are consecutive, so the visible ones are found walking the sorted ids once
+void WriteVisibleTransforms(const vector<uint32_t> &visible, int cascade)
+{
+    size_t next = 0;
+    for (Prop &prop : props)
+    {
+        size_t first = next;
+        uint32_t end = prop.firstPrimitive + (prop.instances.empty() ? 1 : (uint32_t)prop.instances.size());
+        while (next < visible.size() && visible[next] < end)
+            next++;
+        GLsizei count = (GLsizei)(next - first);
+        // the shadow casters which spin are written by UpdateShadowCasterTransforms at each update of the cascade
+        if (cascade >= 0 && prop.spins)
+            continue;
+        GLint &object = cascade >= 0 ? prop.shadowObject[cascade] : prop.object;
+        GLsizei &instances = cascade >= 0 ? prop.shadowInstances[cascade] : prop.visibleInstances;
+        object = -1;
+        instances = 0;
+        // an object outside the frustum is not written
+        if (count == 0)
+            continue;
+        if (prop.instances.empty())
+            object = transformRing.push(prop.modelMatrix);
+        else
+        {
+            // the visible copies have consecutive transforms
+            SnowGL::ObjectTransform *transforms = transformRing.allocate(count, object);
+            if (transforms)
+                for (GLsizei i = 0; i < count; i++)
+                    transforms[i] = prop.instances[visible[first + i] - prop.firstPrimitive];
+        }
+        if (object >= 0)
+            instances = count;
+    }
+}
 
-        
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, textureID[0]);
-    glUniform1i(textureLocation, 0);
-    glUniform1f(repeatLocation, repeat);
-    // we reset to identity at each frame
-    benchModelMatrix = glm::mat4(1.0f);
-    benchNormalMatrix = glm::mat3(1.0f);
-    benchModelMatrix = glm::translate(benchModelMatrix, glm::vec3(0.0f, -1.0f, 0.0f));
-    benchModelMatrix = glm::rotate(benchModelMatrix, glm::radians(orientationY), glm::vec3(0.0f, 1.0f, 0.0f));
-    benchModelMatrix = glm::scale(benchModelMatrix, glm::vec3(0.01f, 0.01f, 0.01f));
-    benchNormalMatrix = glm::inverseTranspose(glm::mat3(view*benchModelMatrix));
-    glUniformMatrix4fv(glGetUniformLocation(shader.Program, "modelMatrix"), 1, GL_FALSE, glm::value_ptr(benchModelMatrix));
-    glUniformMatrix3fv(glGetUniformLocation(shader.Program, "normalMatrix"), 1, GL_FALSE, glm::value_ptr(benchNormalMatrix));
-
-    // we render the bench
-    benchModel.Draw();
-
-    // tree
+// the static casters are found with a query of the hierarchy, when the cache of the cascade is rendered; the objects
+// which spin are few, and they are tested at each update one by one
+void UpdateShadowCasterTransforms(int cascade, bool staticCasters)
+{
+    SNOWGL_PROFILE_SCOPE("ShadowCasterTransforms");
+    lightCuller.setViewProjection(shadowCascades.getFitted(cascade));
+    if (staticCasters)
+    {
+        static vector<uint32_t> casters;
+        sceneBVH.queryFrustum(lightCuller, casters);
+        std::sort(casters.begin(), casters.end());
+        WriteVisibleTransforms(casters, cascade);
+    }
+    for (Prop &prop : props)
+    {
+        if (!prop.spins)
+            continue;
+        GLint &object = prop.shadowObject[cascade];
+        object = lightCuller.isVisible(sceneBVH.getBounds(prop.firstPrimitive)) ? transformRing.push(prop.modelMatrix) : -1;
+        prop.shadowInstances[cascade] = object < 0 ? 0 : 1;
+    }
+}
 
-        
-    glActiveTexture(GL_TEXTURE3);
-    glBindTexture(GL_TEXTURE_2D, textureID[2]);
-    glUniform1i(textureLocation, 3);
-    glUniform1f(repeatLocation, repeat);
-
-    // we reset to identity at each frame
-    treeModelMatrix = glm::mat4(1.0f);
-    treeNormalMatrix = glm::mat3(1.0f);
-    treeModelMatrix = glm::translate(treeModelMatrix, glm::vec3(5.0f, -1.0f, 5.0f));
-    treeModelMatrix = glm::rotate(treeModelMatrix, glm::radians(orientationY), glm::vec3(0.0f, 1.0f, 0.0f));
-    treeModelMatrix = glm::scale(treeModelMatrix, glm::vec3(1.5f, 1.5f, 1.5f));
-    treeNormalMatrix = glm::inverseTranspose(glm::mat3(view*treeModelMatrix));
-    glUniformMatrix4fv(glGetUniformLocation(shader.Program, "modelMatrix"), 1, GL_FALSE, glm::value_ptr(treeModelMatrix));
-    glUniformMatrix3fv(glGetUniformLocation(shader.Program, "normalMatrix"), 1, GL_FALSE, glm::value_ptr(treeNormalMatrix));
-    
-    // we render the tree
-    treeModel.Draw();
+//////////////////////////////////////////
+// we render the objects. We pass also the current rendering step, and the depth map generated in the first step, which is used by the shaders of the second step
+void RenderObjects(Shader &shader, GLint render_pass, GLuint depthMap)
+{
+    SNOWGL_PROFILE_SCOPE("RenderObjects");
+    // For the second rendering step -> we pass the shadow map to the shaders
+    if (render_pass==RENDER)
+    {
+        glActiveTexture(GL_TEXTURE2);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, depthMap);
+        shader.Set(illuminationUniforms.shadowMap, 2);
+    }
+    // the transforms of the objects
+    transformRing.bind(TRANSFORM_UNIT);
+    shader.Set(illuminationUniforms.objectTransforms, TRANSFORM_UNIT);
+
+    // the meshes of the visible objects are tested one by one, in a single batch: an object can be partially visible
+    static SnowGL::SphereSet meshSpheres;
+    static vector<const Mesh *> meshes;
+    static vector<const Prop *> meshProps;
+    static vector<uint32_t> visible;
+    meshSpheres.clear();
+    meshes.clear();
+    meshProps.clear();
+    frameMeshesDrawn = frameMeshesCulled = 0;
+    for (const Prop &prop : props)
+    {
+        GLsizei meshCount = (GLsizei)prop.model->meshes.size();
+        if (!prop.instances.empty())
+        {
+            // the copies have been culled by UpdateObjectTransforms, each with the box of the whole model
+            frameMeshesDrawn += meshCount * prop.visibleInstances;
+            frameMeshesCulled += meshCount * ((GLsizei)prop.instances.size() - prop.visibleInstances);
+            continue;
+        }
+        if (prop.object < 0)
+        {
+            frameMeshesCulled += meshCount;
+            continue;
+        }
+        for (const Mesh &mesh : prop.model->meshes)
+        {
+            meshSpheres.push(mesh.sphere.transformed(prop.modelMatrix));
+            meshes.push_back(&mesh);
+            meshProps.push_back(&prop);
+        }
+    }
+    culler.cull(meshSpheres, visible);
+    frameMeshesCulled += (unsigned int)(meshSpheres.size() - visible.size());
 
-    renderParticles();
+    // we add a draw for each visible mesh of each object, and we sort them so that the draws with the same
+    // program, texture and VAO are consecutive
+    renderList.clear();
+    for (uint32_t i : visible)
+    {
+        renderList.add(illuminationProgram, meshProps[i]->material, meshes[i]->VAO, (GLsizei)meshes[i]->indices.size(), meshProps[i]->object);
+        frameMeshesDrawn++;
+    }
+    for (const Prop &prop : props)
+    {
+        if (prop.instances.empty() || prop.visibleInstances == 0)
+            continue;
+        for (const Mesh &mesh : prop.model->meshes)
+            renderList.add(illuminationProgram, prop.material, mesh.VAO, (GLsizei)mesh.indices.size(), prop.object, prop.visibleInstances);
+    }
+    renderList.sort();
+    renderList.submit();
+}
 
+//////////////////////////////////////////
+// we render the shadow casters of a cascade in the framebuffer bound by shadowCache: the static objects, or those which
+// spin. The shader of the shadow map is in use, with the light matrix of the cascade
+void RenderShadowCasters(Shader &shader, int cascade, bool staticCasters)
+{
+    SNOWGL_PROFILE_SCOPE("RenderShadowCasters");
+    // the transforms of the shadow casters
+    transformRing.bind(TRANSFORM_UNIT);
+    shader.Set(shadowUniforms.objectTransforms, TRANSFORM_UNIT);
+
+    renderList.clear();
+    for (const Prop &prop : props)
+    {
+        if (prop.spins == staticCasters || prop.shadowObject[cascade] < 0)
+            continue;
+        for (const Mesh &mesh : prop.model->meshes)
+            renderList.add(shadowProgram, -1, mesh.VAO, (GLsizei)mesh.indices.size(), prop.shadowObject[cascade], prop.shadowInstances[cascade]);
+        frameShadowCasters += prop.shadowInstances[cascade];
+    }
+    renderList.sort();
+    renderList.submit();
+    frameDrawCalls += renderList.getStats().draws;
 }
 
 //////////////////////////////////////////
 // we load the image from disk and we create an OpenGL texture
 GLint LoadTexture(const char* path)
 {
+    SNOWGL_PROFILE_SCOPE_DETAIL("LoadTexture", path);
     GLuint textureImage;
     int w, h, channels;
     unsigned char* image;
@@ -597,6 +1324,30 @@ GLint LoadTexture(const char* path)
 }
 
 ///////////////////////////////////////////
+// we resolve the uniforms of the illumination shader once, after the link
+void ResolveIlluminationUniforms(const Shader &shader)
+{
+    illuminationUniforms.repeat = shader.GetUniform<GLfloat>("repeat");
+    illuminationUniforms.tex = shader.GetUniform<GLint>("tex");
+    illuminationUniforms.shadowMap = shader.GetUniform<GLint>("shadowMap");
+    illuminationUniforms.objectTransforms = shader.GetUniform<GLint>("objectTransforms");
+    illuminationUniforms.objectIndex = shader.GetUniform<GLint>("objectIndex");
+    illuminationUniforms.cascadeMatrices = shader.GetUniform<glm::mat4>("cascadeMatrices");
+    illuminationUniforms.cascadeSplits = shader.GetUniform<GLfloat>("cascadeSplits");
+    illuminationUniforms.cascadeTexelSizes = shader.GetUniform<GLfloat>("cascadeTexelSizes");
+    illuminationUniforms.cascadeDepthRanges = shader.GetUniform<GLfloat>("cascadeDepthRanges");
+    illuminationUniforms.cascadeCount = shader.GetUniform<GLint>("cascadeCount");
+}
+
+// we resolve the handles of the uniforms of the shader of the shadow map
+void ResolveShadowUniforms(const Shader &shader)
+{
+    shadowUniforms.objectTransforms = shader.GetUniform<GLint>("objectTransforms");
+    shadowUniforms.objectIndex = shader.GetUniform<GLint>("objectIndex");
+    shadowUniforms.lightSpaceMatrix = shader.GetUniform<glm::mat4>("lightSpaceMatrix");
+}
+
+//////////////////////////////////////////
 // The function parses the content of the Shader Program, searches for the Subroutine type names,
 // the subroutines implemented for each type, print the names of the subroutines on the terminal, and add the names of
 // the subroutines to the shaders vector, which is used for the shaders swapping
@@ -637,6 +1388,7 @@ void SetupShader(int program, bool isParticleShader)
                 glGetActiveSubroutineName(program, GL_FRAGMENT_SHADER, s[j], 256, &len, name);
                 std::cout << "\t" << s[j] << " - " << name << "\n";
                 shaders.push_back(name);
+                shaderIndices.push_back(s[j]);
             }
             std::cout << std::endl;
 
@@ -675,23 +1427,35 @@ void SetupShader(int program, bool isParticleShader)
     }
 }
 
-void CompileAndLinkShader() {
+void CompileAndLinkShader(GLSLProgram &program) {
     try {
-		prog.compileShader("Shader/particles_shader.vert");
-		prog.compileShader("Shader/particles_shader.frag");
+		std::vector<std::string> defines;
+		if (packedParticles)
+			defines.push_back("PACKED_PARTICLES");
+		program.compileShader(LoadShaderSource("Shader/particles_shader.vert", defines), GLSLShader::VERTEX, "Shader/particles_shader.vert");
+		program.compileShader("Shader/particles_shader.frag");
 cout << 
         "1 Shaders loaded" << endl;
 	    //////////////////////////////////////////////////////
 		// Setup the transform feedback
-		GLuint progHandle = prog.getHandle();
-		const char * outputNames[] = { "Position", "Velocity", "StartTime" };
-		glTransformFeedbackVaryings(progHandle, 3, outputNames, GL_SEPARATE_ATTRIBS);
+		GLuint progHandle = program.getHandle();
+		// with the interleaved layout, the outputs are written one after the other in a single buffer
+		GLenum bufferMode = interleavedParticles ? GL_INTERLEAVED_ATTRIBS : GL_SEPARATE_ATTRIBS;
+		if (packedParticles) {
+			const char * outputNames[] = { "State" };
+			glTransformFeedbackVaryings(progHandle, 1, outputNames, bufferMode);
+		} else {
+			const char * outputNames[] = { "Position", "Velocity", "StartTime" };
+			glTransformFeedbackVaryings(progHandle, 3, outputNames, bufferMode);
+		}
 		///////////////////////////////////////////////////////
 cout << 
         "2 Transform feedback set" << endl;
-    	prog.link();
+    	program.link();
+        // the projection and view matrices are read from the per-frame uniform buffer
+        SnowGL::FrameUniformBuffer::attach(program.getHandle());
         cout << "3 Shader linked" << endl;
-    	prog.use();
+    	program.use();
         cout << 
         "4 Shader selected" << endl;
     } catch(GLSLProgramException &e ) {
@@ -700,6 +1464,56 @@ cout <<
  		exit( EXIT_FAILURE );
     }
 }
+
+void CompileComputeShader(GLSLProgram &program) {
+    try {
+        std::vector<std::string> defines;
+        if (packedParticles)
+            defines.push_back("PACKED_PARTICLES");
+        program.compileShader(LoadShaderSource("Shader/particles_update.comp", defines), GLSLShader::COMPUTE, "Shader/particles_update.comp");
+        program.link();
+    } catch(GLSLProgramException &e ) {
+        cerr << e.what() << endl;
+        exit( EXIT_FAILURE );
+    }
+}
+
+std::string LoadShaderSource(const char* path, const std::vector<std::string> &defines)
+{
+    std::ifstream file(path, std::ios::in);
+    if (!file)
+        throw GLSLProgramException(std::string("Unable to open: ") + path);
+    std::stringstream code;
+    code << file.rdbuf();
+    std::string source = code.str();
+
+    // the lines #include "name" are replaced by the content of the file, searched in the directory of the shader
+    std::string directory(path);
+    directory = directory.substr(0, directory.find_last_of('/') + 1);
+    size_t include;
+    while ((include = source.find("#include \"")) != std::string::npos) {
+        size_t nameBegin = include + 10;
+        size_t nameEnd = source.find('"', nameBegin);
+        size_t lineEnd = source.find('\n', include);
+        if (nameEnd == std::string::npos || nameEnd > lineEnd)
+            throw GLSLProgramException(std::string("Malformed #include in: ") + path);
+        std::string included = directory + source.substr(nameBegin, nameEnd - nameBegin);
+        source.replace(include, lineEnd == std::string::npos ? std::string::npos : lineEnd - include,
+                       LoadShaderSource(included.c_str(), std::vector<std::string>()));
+    }
+
+    // the defines must follow the #version directive, which has to be the first line
+    std::string lines;
+    for (size_t i = 0; i < defines.size(); i++)
+        lines += "#define " + defines[i] + "\n";
+    size_t version = source.find("#version");
+    if (version != std::string::npos) {
+        size_t versionEnd = source.find('\n', version);
+        source.insert(versionEnd == std::string::npos ? source.size() : versionEnd + 1, lines);
+    }
+    return source;
+}
+
 /////////////////////////////////////////
 // we print on console the name of the currently used shader subroutine
 void PrintCurrentShader(int subroutine)
@@ -711,6 +1525,7 @@ void PrintCurrentShader(int subroutine)
 // If one of the WASD keys is pressed, the camera is moved accordingly (the code is in utils/camera.h)
 void apply_camera_movements()
 {
+    SNOWGL_PROFILE_SCOPE("Camera");
     if(keys[GLFW_KEY_W])
         camera.ProcessKeyboard(FORWARD, deltaTime);
     if(keys[GLFW_KEY_S])
@@ -794,174 +1609,353 @@ void mouse_callback(GLFWwindow* window, double xpos, double ypos)
 
 //---------------------------------------------------------------------------
 
-void initBuffers()
-{
-    nParticles = 4000;
-
-    // Generate the buffers
-    glGenBuffers(2, posBuf);    // position buffers
-    glGenBuffers(2, velBuf);    // velocity buffers
-    glGenBuffers(2, startTime); // Start time buffers
-    glGenBuffers(1, &initVel);  // Initial velocity buffer (never changes, only need one)
-
-    // Allocate space for all buffers
-    int size = nParticles * 3 * sizeof(GLfloat);
-    glBindBuffer(GL_ARRAY_BUFFER, posBuf[0]);
-    glBufferData(GL_ARRAY_BUFFER, size, NULL, GL_DYNAMIC_COPY);
-    glBindBuffer(GL_ARRAY_BUFFER, posBuf[1]);
-    glBufferData(GL_ARRAY_BUFFER, size, NULL, GL_DYNAMIC_COPY);
-    glBindBuffer(GL_ARRAY_BUFFER, velBuf[0]);
-    glBufferData(GL_ARRAY_BUFFER, size, NULL, GL_DYNAMIC_COPY);
-    glBindBuffer(GL_ARRAY_BUFFER, velBuf[1]);
-    glBufferData(GL_ARRAY_BUFFER, size, NULL, GL_DYNAMIC_COPY);
-    glBindBuffer(GL_ARRAY_BUFFER, initVel);
-    glBufferData(GL_ARRAY_BUFFER, size, NULL, GL_STATIC_DRAW);
-    glBindBuffer(GL_ARRAY_BUFFER, startTime[0]);
-    glBufferData(GL_ARRAY_BUFFER, nParticles * sizeof(float), NULL, GL_DYNAMIC_COPY);
-    glBindBuffer(GL_ARRAY_BUFFER, startTime[1]);
-    glBufferData(GL_ARRAY_BUFFER, nParticles * sizeof(float), NULL, GL_DYNAMIC_COPY);
-
-    // Fill the first position buffer with zeroes
-    GLfloat *data = new GLfloat[nParticles * 3];
-    for( int i = 0; i < nParticles * 3; i++ ) data[i] = 0.0f;
-    glBindBuffer(GL_ARRAY_BUFFER, posBuf[0]);
-    glBufferSubData(GL_ARRAY_BUFFER, 0, size, data);
-
-    // Fill the first velocity buffer with random velocities
-    glm::vec3 v(0.0f);
-    float velocity, theta, phi;
-    for( int i = 0; i < nParticles; i++ ) {
-
-		theta = glm::mix(0.0f, glm::pi<float>() / 6.0f, (float)rand() / RAND_MAX);
-		phi = glm::mix(0.0f, glm::two_pi<float>(), (float)rand() / RAND_MAX);
-
-        v.x = sinf(theta) * cosf(phi);
-        v.y = cosf(theta);
-        v.z = sinf(theta) * sinf(phi);
-
-        velocity = glm::mix(1.25f,1.5f,(float)rand() / RAND_MAX);
-        v = glm::normalize(v) * velocity;
-
-        data[3*i]   = v.x;
-        data[3*i+1] = v.y;
-        data[3*i+2] = v.z;
-    }
-    glBindBuffer(GL_ARRAY_BUFFER,velBuf[0]);
-    glBufferSubData(GL_ARRAY_BUFFER, 0, size, data);
-    glBindBuffer(GL_ARRAY_BUFFER,initVel);
-    glBufferSubData(GL_ARRAY_BUFFER, 0, size, data);
-
-    // Fill the first start time buffer
-    delete [] data;
-    data = new GLfloat[nParticles];
-    float time = 0.0f;
-    float rate = 0.001f;
-    for( int i = 0; i < nParticles; i++ ) {
-        data[i] = time;
-        time += rate;
-    }
-    glBindBuffer(GL_ARRAY_BUFFER,startTime[0]);
-    glBufferSubData(GL_ARRAY_BUFFER, 0, nParticles * sizeof(float), data);
-
-    glBindBuffer(GL_ARRAY_BUFFER,0);
-    delete [] data;
-
-    // Create vertex arrays for each set of buffers
-    glGenVertexArrays(2, particleArray);
-
-    // Set up particle array 0
-    glBindVertexArray(particleArray[0]);
-    glBindBuffer(GL_ARRAY_BUFFER, posBuf[0]);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, NULL);
-    glEnableVertexAttribArray(0);
-
-    glBindBuffer(GL_ARRAY_BUFFER, velBuf[0]);
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 0, NULL);
-    glEnableVertexAttribArray(1);
-
-    glBindBuffer(GL_ARRAY_BUFFER, startTime[0]);
-    glVertexAttribPointer(2, 1, GL_FLOAT, GL_FALSE, 0, NULL);
-    glEnableVertexAttribArray(2);
-
-    glBindBuffer(GL_ARRAY_BUFFER, initVel);
-    glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, 0, NULL);
-    glEnableVertexAttribArray(3);
-
-    // Set up particle array 1
-    glBindVertexArray(particleArray[1]);
-    glBindBuffer(GL_ARRAY_BUFFER, posBuf[1]);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, NULL);
-    glEnableVertexAttribArray(0);
-
-    glBindBuffer(GL_ARRAY_BUFFER, velBuf[1]);
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 0, NULL);
-    glEnableVertexAttribArray(1);
-
-    glBindBuffer(GL_ARRAY_BUFFER, startTime[1]);
-    glVertexAttribPointer(2, 1, GL_FLOAT, GL_FALSE, 0, NULL);
-    glEnableVertexAttribArray(2);
-
-    glBindBuffer(GL_ARRAY_BUFFER, initVel);
-    glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, 0, NULL);
-    glEnableVertexAttribArray(3);
-
-    glBindVertexArray(0);
-
-    // Setup the feedback objects
-    glGenTransformFeedbacks(2, feedback);
-
-    // Transform feedback 0
-    glBindTransformFeedback(GL_TRANSFORM_FEEDBACK, feedback[0]);
-    glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, posBuf[0]);
-    glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 1, velBuf[0]);
-    glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 2, startTime[0]);
-
-    // Transform feedback 1
-    glBindTransformFeedback(GL_TRANSFORM_FEEDBACK, feedback[1]);
-    glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, posBuf[1]);
-    glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 1, velBuf[1]);
-    glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 2, startTime[1]);
-
-    glBindTransformFeedback(GL_TRANSFORM_FEEDBACK, 0);
-
-    GLint value;
-    glGetIntegerv(GL_MAX_TRANSFORM_FEEDBACK_BUFFERS, &value);
-    
+void initBuffers(int count)
+{
+    SNOWGL_PROFILE_SCOPE("InitParticleBuffers");
+    nParticles = count;
+
+    // position, velocity and start time are written by the update pass, so with transform feedback they have two copies;
+    // initial velocity and lifetime never change, and are shared by both sets. The compute backend updates in place
+    bool pingPong = particleBackend == FEEDBACK_BACKEND;
+    std::vector<SnowGL::ParticlePool::Stream> layout = {
+        { 3, GL_FLOAT, pingPong },  // PARTICLE_POSITION
+        { 3, GL_FLOAT, pingPong },  // PARTICLE_VELOCITY
+        { 1, GL_FLOAT, pingPong },  // PARTICLE_START_TIME
+        { 3, GL_FLOAT, false },     // PARTICLE_INIT_VELOCITY
+        { 1, GL_FLOAT, false }      // PARTICLE_LIFETIME
+    };
+    // in the packed format the whole state is in a single stream (16 bytes per particle instead of 28)
+    std::vector<SnowGL::ParticlePool::Stream> packedLayout = {
+        { 4, GL_UNSIGNED_INT, pingPong },   // PACKED_STATE
+        { 2, GL_UNSIGNED_INT, false },      // PACKED_INIT_VELOCITY
+        { 1, GL_FLOAT, false }              // PACKED_LIFETIME
+    };
+    particlePool.create(packedParticles ? packedLayout : layout, nParticles, interleavedParticles);
+
+    // every slot emits its first particle at i / particlesPerSecond
+    fillParticleSlots(0, nParticles, 0.0f);
+}
+
+// we write the initial state of the slots [first, first + count): zero position, a random initial velocity,
+// a random lifetime, and a start time which makes the slots emit one after the other at the rate of the settings.
+// Both sets are filled: a slot is not copied by the update pass until it emits its first particle
+void fillParticleSlots(int first, int count, float firstStartTime)
+{
+    SNOWGL_PROFILE_SCOPE("FillParticleSlots");
+    if (count <= 0)
+        return;
+
+    // each slot takes 3 random values (theta, phi, speed) from its index: the slots are filled in parallel,
+    // and the result depends only on PARTICLE_SEED
+    std::vector<glm::vec3> velocities(count);
+    jobs.parallelFor(count, 16384, [&velocities, first](size_t begin, size_t end) {
+        size_t n = end - begin;
+        std::vector<float> u0(n), u1(n), u2(n), u3(n);
+        particleRandom.uniformBatch((uint32_t)(first + begin), n, 0, u0.data(), u1.data(), u2.data(), u3.data());
+
+        glm::vec3 v(0.0f);
+        float velocity, theta, phi;
+        for( size_t j = 0; j < n; j++ ) {
+            theta = glm::mix(0.0f, glm::pi<float>() / 6.0f, u0[j]);
+            phi = glm::mix(0.0f, glm::two_pi<float>(), u1[j]);
+
+            v.x = sinf(theta) * cosf(phi);
+            v.y = cosf(theta);
+            v.z = sinf(theta) * sinf(phi);
+
+            velocity = glm::mix(1.25f,1.5f,u2[j]);
+            velocities[begin + j] = glm::normalize(v) * velocity;
+        }
+    });
+
+    std::vector<float> startTimes(count);
+    float rate = 1.0f / particleSettings.particlesPerSecond;
+    for( int i = 0; i < count; i++ )
+        startTimes[i] = firstStartTime + i * rate;
+
+    if (packedParticles) {
+        // the slots are packed with the same conversions of the shader
+        glm::vec3 domainMin = particleSettings.domainPosition - particleSettings.domainSize * 0.5f;
+        std::vector<uint32_t> state(count * 4), initialVelocity(count * 2);
+        for( int i = 0; i < count; i++ ) {
+            SnowGL::ParticlePacking::packState(glm::vec3(0.0f), velocities[i], startTimes[i], domainMin, particleSettings.domainSize, &state[4*i]);
+            SnowGL::ParticlePacking::packVelocity(velocities[i], &initialVelocity[2*i]);
+        }
+        particlePool.write(PACKED_STATE, first, count, state.data());
+        particlePool.write(PACKED_INIT_VELOCITY, first, count, initialVelocity.data());
+    } else {
+        std::vector<glm::vec3> positions(count, glm::vec3(0.0f));
+        particlePool.write(PARTICLE_POSITION, first, count, positions.data());
+        particlePool.write(PARTICLE_VELOCITY, first, count, velocities.data());
+        particlePool.write(PARTICLE_START_TIME, first, count, startTimes.data());
+        particlePool.write(PARTICLE_INIT_VELOCITY, first, count, velocities.data());
+    }
+
+    writeParticleLifetimes(first, count);
+}
+
+// we fill the lifetime buffer for the slots [first, first + count), in the range of the current settings.
+// The lifetime is the 4th random value of the slot, so it does not change the velocities
+void writeParticleLifetimes(int first, int count)
+{
+    if (count <= 0)
+        return;
+    GLfloat *lifetimes = new GLfloat[count];
+    jobs.parallelFor(count, 16384, [lifetimes, first](size_t begin, size_t end) {
+        size_t n = end - begin;
+        std::vector<float> u0(n), u1(n), u2(n);
+        particleRandom.uniformBatch((uint32_t)(first + begin), n, 0, u0.data(), u1.data(), u2.data(), lifetimes + begin);
+        for( size_t i = begin; i < end; i++ )
+            lifetimes[i] = particleEmitter.lifetime(lifetimes[i]);
+    });
+    particlePool.write(packedParticles ? (int)PACKED_LIFETIME : (int)PARTICLE_LIFETIME, first, count, lifetimes);
+    delete [] lifetimes;
+}
+
+// we time the update and render passes of both layouts, for 100k, 1M and 10M particles.
+// The emission rate is set so that every slot holds a particle: each pass is run LAYOUT_BENCH_STEPS times
+// between two glFinish, and the points are 1 pixel wide, so the render time is not dominated by the fill rate
+#define LAYOUT_BENCH_STEPS 20
+void RunLayoutBenchmark()
+{
+    const int counts[] = { 100000, 1000000, 10000000 };
+    float step = particleClock.getFixedStep();
+    // the particles are seen from a fixed point in front of the domain
+    SnowGL::FrameUniformData frameData = SnowGL::FrameUniformData();
+    frameData.projectionMatrix = glm::perspective(45.0f, (float)screenWidth/(float)screenHeight, 0.1f, 10000.0f);
+    frameData.viewMatrix = glm::lookAt(glm::vec3(0.0f,1.5f,7.0f), glm::vec3(0.0f,1.5f,0.0f), glm::vec3(0.0f,1.0f,0.0f));
+    frameUniforms.update(frameData);
+    glPointSize(1.0f);
+    // the layouts are those of the transform feedback backend
+    particleBackend = FEEDBACK_BACKEND;
+    if (packedParticles)
+        std::cout << "with --packed the state is a single stream: the two layouts are the same" << std::endl;
+    std::cout << "layout       particles   update ms   render ms   update Mp/s   render Mp/s" << std::endl;
+
+    for (int layout = 0; layout < 2; layout++) {
+        interleavedParticles = layout == 1;
+        GLSLProgram program;
+        CompileAndLinkShader(program);
+        GLuint update = glGetSubroutineIndex(program.getHandle(), GL_VERTEX_SHADER, "update");
+        GLuint render = glGetSubroutineIndex(program.getHandle(), GL_VERTEX_SHADER, "render");
+
+        for (int c = 0; c < 3; c++) {
+            int count = counts[c];
+            particleSettings.particlesPerSecond = count / particleSettings.lifetimeMax;
+            initBuffers(count);
+            if (glGetError() == GL_OUT_OF_MEMORY) {
+                std::cout << (interleavedParticles ? "interleaved" : "separate   ") << " " << count << ": out of memory" << std::endl;
+                break;
+            }
+
+            program.use();
+            program.setUniform(ParticleUniform::H, step);
+            program.setUniform(ParticleUniform::Accel, particleSettings.acceleration);
+            program.setUniform(ParticleUniform::EmitPeriod, particleSettings.lifetimeMax);
+            program.setUniform(ParticleUniform::DomainMin, particleSettings.domainPosition - particleSettings.domainSize * 0.5f);
+            program.setUniform(ParticleUniform::DomainSize, particleSettings.domainSize);
+            float time = particleSettings.lifetimeMax;
+            int set = 0;
+
+            glUniformSubroutinesuiv(GL_VERTEX_SHADER, 1, &update);
+            glEnable(GL_RASTERIZER_DISCARD);
+            glFinish();
+            double begin = GetTime();
+            for (int i = 0; i < LAYOUT_BENCH_STEPS; i++) {
+                time += step;
+                program.setUniform(ParticleUniform::Time, time);
+                glBindTransformFeedback(GL_TRANSFORM_FEEDBACK, particlePool.getFeedback(1-set));
+                glBeginTransformFeedback(GL_POINTS);
+                  glBindVertexArray(particlePool.getVertexArray(set));
+                  glDrawArrays(GL_POINTS, 0, count);
+                glEndTransformFeedback();
+                set = 1 - set;
+            }
+            glFinish();
+            double updateTime = (GetTime() - begin) / LAYOUT_BENCH_STEPS;
+            glDisable(GL_RASTERIZER_DISCARD);
+            glBindTransformFeedback(GL_TRANSFORM_FEEDBACK, 0);
+
+            glUniformSubroutinesuiv(GL_VERTEX_SHADER, 1, &render);
+            program.setUniform(ParticleUniform::Interp, 0.0f);
+            glBindVertexArray(particlePool.getVertexArray(set));
+            glFinish();
+            begin = GetTime();
+            for (int i = 0; i < LAYOUT_BENCH_STEPS; i++) {
+                glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+                glDrawArrays(GL_POINTS, 0, count);
+            }
+            glFinish();
+            double renderTime = (GetTime() - begin) / LAYOUT_BENCH_STEPS;
+            glBindVertexArray(0);
+
+            printf("%-11s %10d %11.3f %11.3f %13.1f %13.1f\n", interleavedParticles ? "interleaved" : "separate", count,
+                   updateTime * 1000.0, renderTime * 1000.0, count / updateTime * 1e-6, count / renderTime * 1e-6);
+        }
+    }
+    particlePool.destroy();
+}
+
+// the GPU times of a frame are added to the benchmark report if the frame is recorded (i.e., after the warmup)
+void CollectGpuTimes(SnowGL::BenchReport &report)
+{
+    SnowGL::GpuTimer::FrameTimes times;
+    while (gpuTimer.popResult(times))
+    {
+        if (!benchmark || times.frame < (unsigned long long)benchScenario.warmupFrames)
+            continue;
+        for (int pass = 0; pass < GPU_PASS_COUNT; pass++)
+            report.addSample(std::string("gpu_") + gpuPassNames[pass] + "_ms", times.passMs[pass]);
+        // the scene pass is also recorded for the shadow kernel the frame has been rendered with
+        GLuint kernel = frameShadowKernels[times.frame % (SnowGL::GpuTimer::FRAMES + 1)];
+        report.addSample(std::string("gpu_") + gpuPassNames[SCENE_PASS] + "_" + shaders[kernel] + "_ms", times.passMs[SCENE_PASS]);
+    }
+}
+
+void PrintGpuTimes()
+{
+    cout << "GPU ms:";
+    for (int pass = 0; pass < GPU_PASS_COUNT; pass++)
+        cout << " " << gpuPassNames[pass] << " " << gpuTimer.getAverage(pass);
+    cout << endl;
+}
+
+// we write the zones recorded by the CPU profiler, if a trace was requested
+void WriteProfile()
+{
+    if (profileOutput.empty())
+        return;
+    if (SnowGL::Profiler::writeChromeTrace(profileOutput))
+        cout << "profiler trace written in " << profileOutput << endl;
+    else
+        cout << "Unable to write " << profileOutput << endl;
+}
+
+// seconds elapsed since the first call (at the start of main), measured without GLFW which is not initialized in headless mode
+double GetTime()
+{
+    static const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// we set the uniforms which depend on the settings, in a particle program (render/feedback or compute)
+void SetParticleUniforms(GLSLProgram &program)
+{
+    program.use();
+    program.setUniform(ParticleUniform::EmitPeriod, nParticles / particleSettings.particlesPerSecond);
+    program.setUniform(ParticleUniform::Accel, particleSettings.acceleration);
+    program.setUniform(ParticleUniform::DomainMin, particleSettings.domainPosition - particleSettings.domainSize * 0.5f);
+    program.setUniform(ParticleUniform::DomainSize, particleSettings.domainSize);
+}
+
+// we load the settings file again, and apply it to the running particle system
+void reloadParticleSettings()
+{
+    SNOWGL_PROFILE_SCOPE("ReloadParticleSettings");
+    SnowGL::ParticleSettings previous = particleSettings;
+    particleSettings.fromSettingsFile(PARTICLE_SETTINGS_FILE);
+    if (!particleSettings.isValid())
+    {
+        std::cout << "ERROR::PARTICLESETTINGS:: invalid emission rate or lifetime range, the settings are not applied" << std::endl;
+        particleSettings = previous;
+        return;
+    }
+
+    // the pool grows geometrically, moving the particles in flight on the GPU. The new slots start emitting
+    // from the current simulation time
+    int newCount = particleSettings.getMaxParticles();
+    if (newCount != nParticles) {
+        int oldCount = nParticles;
+        particlePool.resize(newCount);
+        nParticles = newCount;
+        fillParticleSlots(oldCount, newCount - oldCount, (float)particleClock.getTime());
+    }
+    // the lifetime range may have changed: the lifetimes of all the slots are generated again
+    writeParticleLifetimes(0, nParticles);
+
+    // in the packed format, a change of the domain moves the particles in flight, until they are emitted again
+    SetParticleUniforms(prog);
+    if (particleBackend == COMPUTE_BACKEND)
+        SetParticleUniforms(computeProg);
+    std::cout << "Particle settings reloaded: " << nParticles << " particles, " << particlePool.getUsedBytes() << " bytes used of "
+              << particlePool.getReservedBytes() << " reserved" << std::endl;
 }
 
 void renderParticles() {
-            
+    SNOWGL_PROFILE_SCOPE("Particles");
+
+    prog.use();
     glActiveTexture(GL_TEXTURE0);
     glBindTexture(GL_TEXTURE_2D, textureID[3]);
+
     // Update pass
-    glUniformSubroutinesuiv(GL_VERTEX_SHADER, 1, &updateSub);
+    // we run one update for each fixed step to simulate in this frame. drawBuf is the index of the buffers with the current state
+    int steps = particleClock.advance(deltaTime);
+    float step = particleClock.getFixedStep();
+    double time = particleClock.getTime() - steps * (double)step;
+    // the slots which have not emitted a particle yet are skipped
+    for (int i = 0; i < steps; i++)
+      particleEmitter.emit(step);
+    GLsizei liveCount = (GLsizei)glm::min(particleEmitter.getEmittedCount(), (size_t)nParticles);
+
+    gpuTimer.begin(PARTICLE_UPDATE_PASS);
+    if (particleBackend == COMPUTE_BACKEND) {
+      // the streams are bound at their index in the layout, and updated in place
+      computeProg.use();
+      computeProg.setUniform(ParticleUniform::H, step);
+      computeProg.setUniform(ParticleUniform::Count, (GLuint)liveCount);
+      for (size_t s = 0; s < particlePool.getStreamCount(); s++)
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, (GLuint)s, particlePool.getBuffer(s, 0));
+      for (int i = 0; i < steps; i++) {
+        time += step;
+        computeProg.setUniform(ParticleUniform::Time, (float)time);
+        glDispatchCompute((liveCount + 255) / 256, 1, 1);
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+      }
+      frameDispatches += steps;
+      // the render pass reads the buffers as vertex attributes
+      glMemoryBarrier(GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT);
+      prog.use();
+    } else {
+      glUniformSubroutinesuiv(GL_VERTEX_SHADER, 1, &updateSub);
+      prog.setUniform(ParticleUniform::H, step);
 
-    prog.setUniform("Time", lastFrame);
-    prog.setUniform("H", deltaTime);
+      glEnable(GL_RASTERIZER_DISCARD);
 
-    glEnable(GL_RASTERIZER_DISCARD);
+      for (int i = 0; i < steps; i++) {
+        time += step;
+        prog.setUniform(ParticleUniform::Time, (float)time);
 
-    glBindTransformFeedback(GL_TRANSFORM_FEEDBACK, feedback[drawBuf]);
+        glBindTransformFeedback(GL_TRANSFORM_FEEDBACK, particlePool.getFeedback(1-drawBuf));
 
-    glBeginTransformFeedback(GL_POINTS);
-      glBindVertexArray(particleArray[1-drawBuf]);
-      glDrawArrays(GL_POINTS, 0, nParticles);
-    glEndTransformFeedback();
+        glBeginTransformFeedback(GL_POINTS);
+          glBindVertexArray(particlePool.getVertexArray(drawBuf));
+          glDrawArrays(GL_POINTS, 0, liveCount);
+        glEndTransformFeedback();
 
-    glDisable(GL_RASTERIZER_DISCARD);
+        // Swap buffers
+        drawBuf = 1 - drawBuf;
+      }
+      frameDrawCalls += steps;
+
+      glDisable(GL_RASTERIZER_DISCARD);
+    }
+    gpuTimer.end(PARTICLE_UPDATE_PASS);
 
     // Render pass
+    // the particles are extrapolated from the last simulated step to the time of the frame
+    float interp = particleClock.getAlpha() * step;
     glUniformSubroutinesuiv(GL_VERTEX_SHADER, 1, &renderSub);
+    prog.setUniform(ParticleUniform::Time, (float)particleClock.getTime() + interp);
+    prog.setUniform(ParticleUniform::Interp, interp);
     glClear( GL_COLOR_BUFFER_BIT );
-    view = glm::lookAt(glm::vec3(3.0f * cos(angle),1.5f,3.0f * sin(angle)), glm::vec3(0.0f,1.5f,0.0f), glm::vec3(0.0f,1.0f,0.0f));
-    glm::mat4 mv = view * model;
-    prog.setUniform("MVP", projection * mv);
-
-    glBindVertexArray(particleArray[drawBuf]);
-    glDrawTransformFeedback(GL_POINTS, feedback[drawBuf]);
+    // the particles are seen from the camera: projection and view are read from the FrameUniforms block
 
-    // Swap buffers
-    drawBuf = 1 - drawBuf;
+    gpuTimer.begin(PARTICLE_RENDER_PASS);
+    glBindVertexArray(particlePool.getVertexArray(drawBuf));
+    glDrawArrays(GL_POINTS, 0, liveCount);
+    frameDrawCalls++;
+    gpuTimer.end(PARTICLE_RENDER_PASS);
 }
 
 
@@ -0,0 +1,46 @@
+// Packed particle format (see include/utils/ParticlePacking.h), included by the particle shaders
+// when PACKED_PARTICLES is defined. The including shader declares the DomainMin and DomainSize uniforms.
+// x: position xy (unorm16), y: position z (unorm16) | velocity x (half), z: velocity yz (half), w: start time (float)
+
+// packHalf2x16 is not available before GLSL 4.20: halves are converted by hand (round to nearest, no denormals)
+uint toHalf(float value) {
+    uint x = floatBitsToUint(value);
+    uint sign = (x >> 16) & 0x8000u;
+    int exponent = int((x >> 23) & 0xffu) - 127 + 15;
+    uint mantissa = x & 0x7fffffu;
+    if( exponent <= 0 )
+        return sign;
+    if( exponent >= 31 )
+        return sign | 0x7bffu;
+    // the rounding carry from the largest exponent would give infinity: it is clamped to the largest finite half
+    return sign | min((uint(exponent) << 10) + ((mantissa + 0x1000u) >> 13), 0x7bffu);
+}
+
+float fromHalf(uint bits) {
+    uint sign = (bits & 0x8000u) << 16;
+    uint exponent = (bits >> 10) & 0x1fu;
+    uint mantissa = bits & 0x3ffu;
+    if( exponent == 0u )
+        return uintBitsToFloat(sign);
+    return uintBitsToFloat(sign | ((exponent + 112u) << 23) | (mantissa << 13));
+}
+
+void unpackState(uvec4 state, out vec3 position, out vec3 velocity, out float startTime) {
+    vec2 xy = unpackUnorm2x16(state.x);
+    float z = unpackUnorm2x16(state.y & 0xffffu).x;
+    position = DomainMin + vec3(xy, z) * DomainSize;
+    velocity = vec3(fromHalf(state.y >> 16), fromHalf(state.z & 0xffffu), fromHalf(state.z >> 16));
+    startTime = uintBitsToFloat(state.w);
+}
+
+uvec4 packState(vec3 position, vec3 velocity, float startTime) {
+    vec3 p = clamp((position - DomainMin) / DomainSize, 0.0, 1.0);
+    return uvec4(packUnorm2x16(p.xy),
+                 (packUnorm2x16(vec2(p.z, 0.0)) & 0xffffu) | (toHalf(velocity.x) << 16),
+                 toHalf(velocity.y) | (toHalf(velocity.z) << 16),
+                 floatBitsToUint(startTime));
+}
+
+vec3 unpackVelocity(uvec2 bits) {
+    return vec3(fromHalf(bits.x & 0xffffu), fromHalf(bits.x >> 16), fromHalf(bits.y & 0xffffu));
+}
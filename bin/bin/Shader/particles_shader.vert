@@ -3,58 +3,124 @@
 subroutine void RenderPassType();
 subroutine uniform RenderPassType RenderPass;
 
+#ifdef PACKED_PARTICLES
+// Packed format, see particles_packing.glsl
+layout (location = 0) in uvec4 VertexState;
+layout (location = 1) in uvec2 VertexPackedInitialVelocity; // half x3
+layout (location = 2) in float VertexLifetime;
+
+flat out uvec4 State;   // To transform feedback
+
+uniform vec3 DomainMin;  // Lower corner of the particle domain
+uniform vec3 DomainSize; // Size of the particle domain
+#else
 layout (location = 0) in vec3 VertexPosition;
 layout (location = 1) in vec3 VertexVelocity;
 layout (location = 2) in float VertexStartTime;
 layout (location = 3) in vec3 VertexInitialVelocity;
+layout (location = 4) in float VertexLifetime;
 
 // Layout specifiers only available in OpenGL 4.4
 /*layout( xfb_buffer = 0, xfb_offset=0 )*/ out vec3 Position;   // To transform feedback
 /*layout( xfb_buffer = 1, xfb_offset=0 )*/ out vec3 Velocity;   // To transform feedback
 /*layout( xfb_buffer = 2, xfb_offset=0 )*/ out float StartTime; // To transform feedback
+#endif
 out float Transp;    // To fragment shader
 
 uniform float Time;  // Simulation time
-uniform float H;     // Elapsed time between frames
+uniform float H;     // Fixed simulation step
+uniform float Interp; // Time elapsed since the last update step (render pass only)
 uniform vec3 Accel;  // Particle acceleration
-uniform float ParticleLifetime;  // Particle lifespan
+uniform float EmitPeriod;  // Time between two particles emitted by the same slot
+
+// values shared by all the programs, written once per frame in a uniform buffer (see include/utils/FrameUniforms.h)
+// the block must have the same declaration in every shader
+layout (std140) uniform FrameUniforms {
+    // projection and view matrices of the camera
+    mat4 projectionMatrix;
+    mat4 viewMatrix;
+    vec3 lightVector;
+    float Kd;
+    float alpha;
+    float F0;
+};
+
+// The particle state, decoded in main() from the vertex attributes
+vec3 particlePosition;
+vec3 particleVelocity;
+float particleStartTime;
+vec3 particleInitialVelocity;
+
+#ifdef PACKED_PARTICLES
+#include "particles_packing.glsl"
+
+void decodeState() {
+    unpackState(VertexState, particlePosition, particleVelocity, particleStartTime);
+    particleInitialVelocity = unpackVelocity(VertexPackedInitialVelocity);
+}
+
+void writeState(vec3 position, vec3 velocity, float startTime) {
+    State = packState(position, velocity, startTime);
+}
+#else
+void decodeState() {
+    particlePosition = VertexPosition;
+    particleVelocity = VertexVelocity;
+    particleStartTime = VertexStartTime;
+    particleInitialVelocity = VertexInitialVelocity;
+}
 
-uniform mat4 MVP;
+void writeState(vec3 position, vec3 velocity, float startTime) {
+    Position = position;
+    Velocity = velocity;
+    StartTime = startTime;
+}
+#endif
 
 subroutine (RenderPassType)
 void update() {
 
     // Update position & velocity for next frame
-    Position = VertexPosition;
-    Velocity = VertexVelocity;
-    StartTime = VertexStartTime;
+    vec3 position = particlePosition;
+    vec3 velocity = particleVelocity;
+    float startTime = particleStartTime;
 
-    if( Time >= StartTime ) {
+    if( Time >= startTime ) {
 
-        float age = Time - StartTime;
+        float age = Time - startTime;
 
-        if( age > ParticleLifetime ) {
-            // The particle is past it's lifetime, recycle.
-            Position = vec3(0.0);
-            Velocity = VertexInitialVelocity;
-            StartTime = Time;
-        } else {
+        if( age >= EmitPeriod ) {
+            // The slot emits a new particle
+            position = vec3(0.0);
+            velocity = particleInitialVelocity;
+            startTime = Time - mod(age, EmitPeriod);
+        } else if( age < VertexLifetime ) {
             // The particle is alive, update.
-            Position += Velocity * H;
-            Velocity += Accel * H;
+            position += velocity * H;
+            velocity += Accel * H;
         }
+        // otherwise the particle is past it's lifetime, and the slot waits for the next emission
     }
+    writeState(position, velocity, startTime);
 }
 
 subroutine (RenderPassType)
 void render() {
-    float age = Time - VertexStartTime;
-    Transp = 1.0 - age / ParticleLifetime;
-    gl_Position = MVP * vec4(VertexPosition, 1.0);
+    float age = Time - particleStartTime;
+    Transp = 1.0 - age / VertexLifetime;
+    if( age < 0.0 || age > VertexLifetime ) {
+        // The slot has no alive particle: we place it outside the clip volume
+        gl_Position = vec4(0.0, 0.0, 2.0, 1.0);
+        return;
+    }
+    // we move the particle forward from the last simulated step to the time of the frame
+    // the particles are in world coordinates
+    gl_Position = projectionMatrix * viewMatrix * vec4(particlePosition + particleVelocity * Interp, 1.0);
 }
 
 void main()
 {
+    decodeState();
     // This will call either render() or update()
     RenderPass();
 }
@@ -2,6 +2,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <math.h>
+#include <chrono>
 #include <glfw/glfw3.h>
 #include <glad/glad.h>
 #include <glm/glm.hpp>
@@ -9,12 +10,27 @@
 #include <glm/gtc/matrix_inverse.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
-#define MAX_PARTICLES 1000
+#include <utils/ParticleStore.h>
+#include <utils/JobPool.h>
+#include <utils/SimulationClock.h>
+#include <utils/ParticleSettings.h>
+#include <utils/ParticleEmitter.h>
+#include <utils/ParticleRandom.h>
+
 #define WCX		640
 #define WCY		480
 #define RAIN	0
 #define SNOW	1
 #define	HAIL	2
+// particles updated by each job of the pool: a multiple of ParticleStore::LANES, and
+// independent from the number of threads, so the result is the same on every machine
+#define UPDATE_CHUNK	16384
+// the particles are updated at this rate, independently from the frame rate
+#define SIM_STEP		(1.0f/60.0f)
+// maximum number of steps simulated in a frame: after a hitch, the excess time is dropped
+#define SIM_MAX_STEPS	5
+// seed of the random values of the particles
+#define PARTICLE_SEED	161
 
 
 float slowdown = 2.0;
@@ -35,27 +51,29 @@ float ground_points[21][21][3];
 float ground_colors[21][21][4];
 float accum = -10.0;
 
-typedef struct {
-  // Life
-  bool alive;	// is the particle alive?
-  float life;	// particle lifespan
-  float fade; // decay
-  // color
-  float red;
-  float green;
-  float blue;
-  // Position/direction
-  float xpos;
-  float ypos;
-  float zpos;
-  // Velocity/Direction, only goes down in y dir
-  float vel;
-  // Gravity
-  float gravity;
-}particles;
+// emission of the particles: rate, and lifetime range in seconds
+SnowGL::ParticleSettings precipitationSettings() {
+  SnowGL::ParticleSettings settings;
+  settings.particlesPerSecond = 200;
+  settings.lifetimeMin = 0.2f;
+  settings.lifetimeMax = 5.5f;
+  return settings;
+}
+SnowGL::ParticleSettings par_settings = precipitationSettings();
 
 // Paticle System
-particles par_sys[MAX_PARTICLES];
+// every attribute is stored in its own aligned stream (see include/utils/ParticleStore.h),
+// so the update of position, velocity and life runs with SSE/AVX instructions
+// the alive particles are kept contiguous, so all the loops only visit [0, getAliveCount())
+SnowGL::ParticleStore par_sys(par_settings.getMaxParticles());
+// new particles are spawned by the emitter, following par_settings
+SnowGL::ParticleEmitter emitter(par_settings);
+// counter-based generator: the values of a particle depend only on the seed, its emission number and the step
+SnowGL::ParticleRandom par_random(PARTICLE_SEED);
+// the update is split in chunks, running on one thread for each core
+SnowGL::JobPool update_jobs;
+// fixed timestep clock driving the updates
+SnowGL::SimulationClock sim_clock(SIM_STEP, SIM_MAX_STEPS);
 
 void normal_keys(unsigned char key, int x, int y) {
   if (key == 'r') { // Rain
@@ -93,22 +111,30 @@ void special_keys(int key, int x, int y) {
 
 
 // Initialize/Reset Particles - give them their attributes
-void initParticles(int i) {
-    par_sys[i].alive = true;
-    par_sys[i].life = 1.0;
-    par_sys[i].fade = float(rand()%100)/1000.0f+0.003f;
-
-    par_sys[i].xpos = (float) (rand() % 21) - 10;
-    par_sys[i].ypos = 10.0;
-    par_sys[i].zpos = (float) (rand() % 21) - 10;
-
-    par_sys[i].red = 0.5;
-    par_sys[i].green = 0.5;
-    par_sys[i].blue = 1.0;
-
-    par_sys[i].vel = velocity;
-    par_sys[i].gravity = -0.8;//-0.8;
-
+// the new particles are in the slots [first, first + count), and serial is the emission number of the first one.
+// Each particle takes its random values from its emission number and the simulation step, so the spawn runs in
+// parallel and the sequence is the same on every run
+void initParticles(size_t first, size_t count, size_t serial) {
+  uint32_t step = (uint32_t)sim_clock.getStepCount();
+  update_jobs.parallelFor(count, UPDATE_CHUNK, [first, serial, step](size_t begin, size_t end) {
+    size_t p = first + begin;
+    size_t n = end - begin;
+    // we write the random values in the streams, and we map them to the attributes ranges
+    par_random.uniformBatch((uint32_t)(serial + begin), n, step, par_sys.fade + p, par_sys.xpos + p, par_sys.zpos + p, par_sys.yprev + p);
+    for (size_t i = p; i < p + n; i++) {
+      // life goes from 1 to 0 in a lifetime chosen by the emitter
+      par_sys.life[i] = 1.0;
+      par_sys.fade[i] = SIM_STEP / emitter.lifetime(par_sys.fade[i]);
+
+      par_sys.xpos[i] = floorf(par_sys.xpos[i] * 21) - 10;
+      par_sys.ypos[i] = 10.0;
+      par_sys.yprev[i] = par_sys.ypos[i];
+      par_sys.zpos[i] = floorf(par_sys.zpos[i] * 21) - 10;
+
+      par_sys.vel[i] = velocity;
+      par_sys.gravity[i] = -0.8;//-0.8;
+    }
+  });
 }
 
 void init( ) {
@@ -134,154 +160,163 @@ void init( ) {
       }
     }
 
-    // Initialize particles
-    for (loop = 0; loop < MAX_PARTICLES; loop++) {
-        initParticles(loop);
-    }
+    // Initialize particles: the emitter will spawn them over time
+    par_sys.clear();
 }
 
 // For Rain
-void drawRain() {
-  float x, y, z;
-  for (loop = 0; loop < MAX_PARTICLES; loop=loop+2) {
-    if (par_sys[loop].alive == true) {
-      x = par_sys[loop].xpos;
-      y = par_sys[loop].ypos;
-      z = par_sys[loop].zpos + zoom;
-
-      // Draw particles
-      glColor3f(0.5, 0.5, 1.0);
-      glBegin(GL_LINES);
-        glVertex3f(x, y, z);
-        glVertex3f(x, y+0.5, z);
-      glEnd();
-
-      // Update values
-      //Move
-      // Adjust slowdown for speed!
-      par_sys[loop].ypos += par_sys[loop].vel / (slowdown*1000);
-      par_sys[loop].vel += par_sys[loop].gravity;
-      // Decay
-      par_sys[loop].life -= par_sys[loop].fade;
-
-      if (par_sys[loop].ypos <= -10) {
-        par_sys[loop].life = -1.0;
-      }
-      //Revive
-      if (par_sys[loop].life < 0.0) {
-        initParticles(loop);
+// one fixed step of the simulation
+void updateRain() {
+  //Move and Decay, for all the particles at once
+  // Adjust slowdown for speed!
+  float velDivisor = slowdown*1000;
+  update_jobs.parallelFor(par_sys.getAliveCount(), UPDATE_CHUNK, [velDivisor](size_t begin, size_t end) {
+    par_sys.integrate(begin, end, velDivisor);
+    for (size_t i = begin; i < end; i++) {
+      if (par_sys.ypos[i] <= -10) {
+        par_sys.life[i] = -1.0;
       }
     }
-  }
+  });
+
+  // Remove the dead particles, and emit the new ones
+  par_sys.killExpired();
+  emitter.emit(SIM_STEP, par_sys, initParticles);
 }
 
-// For Hail
-void drawHail() {
+// alpha: position of the frame between the last two simulation steps
+void drawRain(float alpha) {
   float x, y, z;
+  int alive = par_sys.getAliveCount();
+  for (loop = 0; loop < alive; loop++) {
+    x = par_sys.xpos[loop];
+    y = par_sys.yprev[loop] + (par_sys.ypos[loop] - par_sys.yprev[loop]) * alpha;
+    z = par_sys.zpos[loop] + zoom;
+
+    // Draw particles
+    glColor3f(0.5, 0.5, 1.0);
+    glBegin(GL_LINES);
+      glVertex3f(x, y, z);
+      glVertex3f(x, y+0.5, z);
+    glEnd();
+  }
+}
 
-  for (loop = 0; loop < MAX_PARTICLES; loop=loop+2) {
-    if (par_sys[loop].alive == true) {
-      x = par_sys[loop].xpos;
-      y = par_sys[loop].ypos;
-      z = par_sys[loop].zpos + zoom;
-
-      // Draw particles
-      glColor3f(0.8, 0.8, 0.9);
-      glBegin(GL_QUADS);
-        // Front
-        glVertex3f(x-hailsize, y-hailsize, z+hailsize); // lower left
-        glVertex3f(x-hailsize, y+hailsize, z+hailsize); // upper left
-        glVertex3f(x+hailsize, y+hailsize, z+hailsize); // upper right
-        glVertex3f(x+hailsize, y-hailsize, z+hailsize); // lower left
-        //Left
-        glVertex3f(x-hailsize, y-hailsize, z+hailsize);
-        glVertex3f(x-hailsize, y-hailsize, z-hailsize);
-        glVertex3f(x-hailsize, y+hailsize, z-hailsize);
-        glVertex3f(x-hailsize, y+hailsize, z+hailsize);
-        // Back
-        glVertex3f(x-hailsize, y-hailsize, z-hailsize);
-        glVertex3f(x-hailsize, y+hailsize, z-hailsize);
-        glVertex3f(x+hailsize, y+hailsize, z-hailsize);
-        glVertex3f(x+hailsize, y-hailsize, z-hailsize);
-        //Right
-        glVertex3f(x+hailsize, y+hailsize, z+hailsize);
-        glVertex3f(x+hailsize, y+hailsize, z-hailsize);
-        glVertex3f(x+hailsize, y-hailsize, z-hailsize);
-        glVertex3f(x+hailsize, y-hailsize, z+hailsize);
-        //Top
-        glVertex3f(x-hailsize, y+hailsize, z+hailsize);
-        glVertex3f(x-hailsize, y+hailsize, z-hailsize);
-        glVertex3f(x+hailsize, y+hailsize, z-hailsize);
-        glVertex3f(x+hailsize, y+hailsize, z+hailsize);
-        //Bottom
-        glVertex3f(x-hailsize, y-hailsize, z+hailsize);
-        glVertex3f(x-hailsize, y-hailsize, z-hailsize);
-        glVertex3f(x+hailsize, y-hailsize, z-hailsize);
-        glVertex3f(x+hailsize, y-hailsize, z+hailsize);
-      glEnd();
-
-      // Update values
-      //Move
-      if (par_sys[loop].ypos <= -10) {
-        par_sys[loop].vel = par_sys[loop].vel * -1.0;
-      }
-      par_sys[loop].ypos += par_sys[loop].vel / (slowdown*1000); // * 1000
-      par_sys[loop].vel += par_sys[loop].gravity;
+// For Hail
+void updateHail() {
+  //Move: hailstones bounce on the ground
+  float velDivisor = slowdown*1000; // * 1000
+  update_jobs.parallelFor(par_sys.getAliveCount(), UPDATE_CHUNK, [velDivisor](size_t begin, size_t end) {
+    par_sys.reflectBelow(begin, end, -10);
+    par_sys.integrate(begin, end, velDivisor);
+  });
+
+  // Remove the dead particles, and emit the new ones
+  par_sys.killExpired();
+  emitter.emit(SIM_STEP, par_sys, initParticles);
+}
 
-      // Decay
-      par_sys[loop].life -= par_sys[loop].fade;
+void drawHail(float alpha) {
+  float x, y, z;
+  int alive = par_sys.getAliveCount();
+
+  for (loop = 0; loop < alive; loop++) {
+    x = par_sys.xpos[loop];
+    y = par_sys.yprev[loop] + (par_sys.ypos[loop] - par_sys.yprev[loop]) * alpha;
+    z = par_sys.zpos[loop] + zoom;
+
+    // Draw particles
+    glColor3f(0.8, 0.8, 0.9);
+    glBegin(GL_QUADS);
+      // Front
+      glVertex3f(x-hailsize, y-hailsize, z+hailsize); // lower left
+      glVertex3f(x-hailsize, y+hailsize, z+hailsize); // upper left
+      glVertex3f(x+hailsize, y+hailsize, z+hailsize); // upper right
+      glVertex3f(x+hailsize, y-hailsize, z+hailsize); // lower left
+      //Left
+      glVertex3f(x-hailsize, y-hailsize, z+hailsize);
+      glVertex3f(x-hailsize, y-hailsize, z-hailsize);
+      glVertex3f(x-hailsize, y+hailsize, z-hailsize);
+      glVertex3f(x-hailsize, y+hailsize, z+hailsize);
+      // Back
+      glVertex3f(x-hailsize, y-hailsize, z-hailsize);
+      glVertex3f(x-hailsize, y+hailsize, z-hailsize);
+      glVertex3f(x+hailsize, y+hailsize, z-hailsize);
+      glVertex3f(x+hailsize, y-hailsize, z-hailsize);
+      //Right
+      glVertex3f(x+hailsize, y+hailsize, z+hailsize);
+      glVertex3f(x+hailsize, y+hailsize, z-hailsize);
+      glVertex3f(x+hailsize, y-hailsize, z-hailsize);
+      glVertex3f(x+hailsize, y-hailsize, z+hailsize);
+      //Top
+      glVertex3f(x-hailsize, y+hailsize, z+hailsize);
+      glVertex3f(x-hailsize, y+hailsize, z-hailsize);
+      glVertex3f(x+hailsize, y+hailsize, z-hailsize);
+      glVertex3f(x+hailsize, y+hailsize, z+hailsize);
+      //Bottom
+      glVertex3f(x-hailsize, y-hailsize, z+hailsize);
+      glVertex3f(x-hailsize, y-hailsize, z-hailsize);
+      glVertex3f(x+hailsize, y-hailsize, z-hailsize);
+      glVertex3f(x+hailsize, y-hailsize, z+hailsize);
+    glEnd();
+  }
+}
 
-      //Revive
-      if (par_sys[loop].life < 0.0) {
-        initParticles(loop);
+// For Snow
+void updateSnow() {
+  //Move and Decay
+  float velDivisor = slowdown*1000;
+  update_jobs.parallelFor(par_sys.getAliveCount(), UPDATE_CHUNK, [velDivisor](size_t begin, size_t end) {
+    par_sys.integrate(begin, end, velDivisor);
+  });
+
+  // the accumulation on the ground is shared between particles, so it stays serial
+  int alive = par_sys.getAliveCount();
+  for (loop = 0; loop < alive; loop++) {
+    if (par_sys.ypos[loop] <= -10) {
+      int zi = par_sys.zpos[loop] + 10;
+      int xi = par_sys.xpos[loop] + 10;
+      ground_colors[zi][xi][0] = 1.0;
+      ground_colors[zi][xi][2] = 1.0;
+      ground_colors[zi][xi][3] += 1.0;
+      if (ground_colors[zi][xi][3] > 1.0) {
+        ground_points[xi][zi][1] += 0.1;
       }
+      par_sys.life[loop] = -1.0;
     }
   }
+
+  // Remove the dead particles, and emit the new ones
+  par_sys.killExpired();
+  emitter.emit(SIM_STEP, par_sys, initParticles);
 }
 
-// For Snow
-void drawSnow() {
+void drawSnow(float alpha) {
   float x, y, z;
-  for (loop = 0; loop < MAX_PARTICLES; loop=loop+2) {
-    if (par_sys[loop].alive == true) {
-      x = par_sys[loop].xpos;
-      y = par_sys[loop].ypos;
-      z = par_sys[loop].zpos + zoom;
-
-      // Draw particles
-      glColor3f(1.0, 1.0, 1.0);
-      glPushMatrix();
-      glTranslatef(x, y, z);
-   //   glutSolidSphere(0.2, 16, 16);
-      glPopMatrix();
-
-      // Update values
-      //Move
-      par_sys[loop].ypos += par_sys[loop].vel / (slowdown*1000);
-      par_sys[loop].vel += par_sys[loop].gravity;
-      // Decay
-      par_sys[loop].life -= par_sys[loop].fade;
-
-      if (par_sys[loop].ypos <= -10) {
-        int zi = z - zoom + 10;
-        int xi = x + 10;
-        ground_colors[zi][xi][0] = 1.0;
-        ground_colors[zi][xi][2] = 1.0;
-        ground_colors[zi][xi][3] += 1.0;
-        if (ground_colors[zi][xi][3] > 1.0) {
-          ground_points[xi][zi][1] += 0.1;
-        }
-        par_sys[loop].life = -1.0;
-      }
-
-      //Revive
-      if (par_sys[loop].life < 0.0) {
-        initParticles(loop);
-      }
-    }
+  int alive = par_sys.getAliveCount();
+  for (loop = 0; loop < alive; loop++) {
+    x = par_sys.xpos[loop];
+    y = par_sys.yprev[loop] + (par_sys.ypos[loop] - par_sys.yprev[loop]) * alpha;
+    z = par_sys.zpos[loop] + zoom;
+
+    // Draw particles
+    glColor3f(1.0, 1.0, 1.0);
+    glPushMatrix();
+    glTranslatef(x, y, z);
+ //   glutSolidSphere(0.2, 16, 16);
+    glPopMatrix();
   }
 }
 
+// seconds elapsed since the previous call
+float frameTime() {
+  static std::chrono::steady_clock::time_point last = std::chrono::steady_clock::now();
+  std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+  float elapsed = std::chrono::duration<float>(now - last).count();
+  last = now;
+  return elapsed;
+}
+
 // Draw Particles
 void drawScene( ) {
   int i, j;
@@ -324,12 +359,19 @@ void drawScene( ) {
     }
   glEnd();
   // Which Particles
+  // the simulation advances in fixed steps, whatever the frame rate, and the
+  // particles are drawn interpolating between the last two steps
+  int steps = sim_clock.advance(frameTime());
+  float alpha = sim_clock.getAlpha();
   if (fall == RAIN) {
-    drawRain();
+    for (i = 0; i < steps; i++) updateRain();
+    drawRain(alpha);
   }else if (fall == HAIL) {
-    drawHail();
+    for (i = 0; i < steps; i++) updateHail();
+    drawHail(alpha);
   }else if (fall == SNOW) {
-    drawSnow();
+    for (i = 0; i < steps; i++) updateSnow();
+    drawSnow(alpha);
   }
 
 }
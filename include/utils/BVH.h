@@ -0,0 +1,422 @@
+#pragma once
+
+// cstdlib
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+// external libs
+#include <glm/glm.hpp>
+
+// program
+#include <utils/Bounds.h>
+#include <utils/FrustumCuller.h>
+
+namespace SnowGL
+{
+	/*! @class BVH
+	*	@brief Bounding volume hierarchy over the boxes of the scene instances
+	*
+	*	The tree is built top-down with the surface area heuristic, evaluated on BINS buckets of the centroids on each
+	*	axis; a node becomes a leaf when splitting it would cost more than testing its primitives (at most MAX_LEAF).
+	*	The nodes are stored depth-first, each after its parent, and the primitives of a subtree are contiguous.
+	*	When an instance moves, setBounds() updates its box and refit() enlarges or shrinks the boxes of its ancestors,
+	*	keeping the topology: the tree stays correct, and it needs a build only when the objects have moved so much that
+	*	the boxes overlap too much (getCost() grows).
+	*	The same tree is traversed for the culling against the camera or the light frustum, and for the ray queries.
+	*/
+	class BVH
+	{
+	public:
+		static const int BINS = 12;			/**< The buckets of the SAH evaluation, on each axis */
+		static const uint32_t MAX_LEAF = 4;	/**< The maximum number of primitives in a leaf */
+
+		/*! @struct Stats
+		*	@brief The work of the last query
+		*/
+		struct Stats
+		{
+			unsigned int nodes = 0;			/**< The nodes visited */
+			unsigned int primitives = 0;	/**< The primitives tested (or accepted with a whole subtree) */
+		};
+
+		/** @brief Builds the tree
+		*	@param _bounds The boxes of the primitives, in world coordinates (the index of a box is the id of the primitive)
+		*/
+		void build(const std::vector<AABB> &_bounds)
+		{
+			uint32_t count = (uint32_t)_bounds.size();
+			m_bounds = _bounds;
+			m_nodes.clear();
+			m_nodes.reserve(count > 0 ? 2 * count - 1 : 0);
+			m_parents.clear();
+			m_primitives.resize(count);
+			m_leaves.resize(count);
+			m_centroids.resize(count);
+			m_dirty.clear();
+			for (uint32_t i = 0; i < count; ++i)
+			{
+				m_primitives[i] = i;
+				m_centroids[i] = _bounds[i].getCenter();
+			}
+			if (count == 0)
+				return;
+			m_nodes.push_back(Node());
+			m_parents.push_back(0);
+			m_nodes[0].first = 0;
+			m_nodes[0].count = count;
+			split(0);
+		}
+
+		/** @brief Changes the box of a primitive: the tree is updated by the next refit()
+		*	@param _primitive The id of the primitive
+		*	@param _bounds The new box, in world coordinates
+		*/
+		inline void setBounds(uint32_t _primitive, const AABB &_bounds)
+		{
+			m_bounds[_primitive] = _bounds;
+			m_dirty.push_back(m_leaves[_primitive]);
+		}
+
+		/** @brief Updates the boxes of the ancestors of the primitives changed by setBounds()
+		*
+		*	With few changes, the path from each leaf is walked up until a box does not change; with many, all the nodes
+		*	are refitted in reverse order, children first.
+		*/
+		void refit()
+		{
+			if (m_dirty.empty())
+				return;
+			if (m_dirty.size() * 8 > m_nodes.size())
+			{
+				for (size_t i = m_nodes.size(); i-- > 0;)
+					fit((uint32_t)i);
+			}
+			else
+			{
+				for (uint32_t node : m_dirty)
+				{
+					fit(node);
+					while (node != 0)
+					{
+						node = m_parents[node];
+						if (!fit(node))
+							break;
+					}
+				}
+			}
+			m_dirty.clear();
+		}
+
+		/** @brief Frustum query: subtrees entirely inside are accepted without testing their primitives
+		*	@param _frustum The frustum (of the camera, or of the light for the shadow casters)
+		*	@param _visible The ids of the primitives inside or intersecting the frustum, in no particular order (the
+		*	vector is cleared first)
+		*	@return The number of primitives found
+		*/
+		size_t queryFrustum(const FrustumCuller &_frustum, std::vector<uint32_t> &_visible)
+		{
+			_visible.clear();
+			m_stats = Stats();
+			if (m_nodes.empty())
+				return 0;
+			// the stack keeps the planes still to test with each node
+			m_stack.clear();
+			m_stack.push_back(StackEntry{ 0, FrustumCuller::ALL_PLANES });
+			while (!m_stack.empty())
+			{
+				StackEntry entry = m_stack.back();
+				m_stack.pop_back();
+				const Node &node = m_nodes[entry.node];
+				++m_stats.nodes;
+				unsigned planes = entry.planes;
+				FrustumCuller::Containment containment = _frustum.classify(node.bounds, planes);
+				if (containment == FrustumCuller::OUTSIDE)
+					continue;
+				if (containment == FrustumCuller::INSIDE)
+				{
+					_visible.insert(_visible.end(), m_primitives.begin() + node.first, m_primitives.begin() + node.first + node.count);
+					m_stats.primitives += node.count;
+				}
+				else if (node.left == 0)
+				{
+					for (uint32_t i = node.first; i < node.first + node.count; ++i)
+					{
+						unsigned primitivePlanes = planes;
+						++m_stats.primitives;
+						if (_frustum.classify(m_bounds[m_primitives[i]], primitivePlanes) != FrustumCuller::OUTSIDE)
+							_visible.push_back(m_primitives[i]);
+					}
+				}
+				else
+				{
+					m_stack.push_back(StackEntry{ node.left, planes });
+					m_stack.push_back(StackEntry{ node.left + 1, planes });
+				}
+			}
+			return _visible.size();
+		}
+
+		/** @brief Ray query: the nearest primitive hit by a ray
+		*	@param _origin The origin of the ray
+		*	@param _direction The direction of the ray (the distances are in its units)
+		*	@param _tMax The maximum distance
+		*	@param _intersect A functor bool(uint32_t primitive, float tBox, float &t), called for the primitives whose box
+		*	is hit at tBox: it returns true, and sets t, if the primitive is hit nearer than t. It can just accept tBox
+		*	@param _t The distance of the hit
+		*	@return The id of the primitive hit, or -1
+		*/
+		template <typename Intersect>
+		int queryRay(const glm::vec3 &_origin, const glm::vec3 &_direction, float _tMax, Intersect _intersect, float &_t)
+		{
+			m_stats = Stats();
+			int hit = -1;
+			_t = _tMax;
+			if (m_nodes.empty())
+				return hit;
+			glm::vec3 inverseDirection = 1.0f / _direction;
+			float tNear;
+			if (!m_nodes[0].bounds.intersectRay(_origin, inverseDirection, _t, tNear))
+				return hit;
+			m_rayStack.clear();
+			m_rayStack.push_back(RayEntry{ 0, tNear });
+			while (!m_rayStack.empty())
+			{
+				RayEntry entry = m_rayStack.back();
+				m_rayStack.pop_back();
+				// a node entered after the nearest hit cannot contain a nearer one
+				if (entry.tNear > _t)
+					continue;
+				const Node &node = m_nodes[entry.node];
+				++m_stats.nodes;
+				if (node.left == 0)
+				{
+					for (uint32_t i = node.first; i < node.first + node.count; ++i)
+					{
+						uint32_t primitive = m_primitives[i];
+						++m_stats.primitives;
+						if (m_bounds[primitive].intersectRay(_origin, inverseDirection, _t, tNear) && _intersect(primitive, tNear, _t))
+							hit = (int)primitive;
+					}
+					continue;
+				}
+				// the nearer child is visited first
+				float tLeft, tRight;
+				bool left = m_nodes[node.left].bounds.intersectRay(_origin, inverseDirection, _t, tLeft);
+				bool right = m_nodes[node.left + 1].bounds.intersectRay(_origin, inverseDirection, _t, tRight);
+				if (left && right && tLeft < tRight)
+				{
+					m_rayStack.push_back(RayEntry{ node.left + 1, tRight });
+					m_rayStack.push_back(RayEntry{ node.left, tLeft });
+				}
+				else
+				{
+					if (left)
+						m_rayStack.push_back(RayEntry{ node.left, tLeft });
+					if (right)
+						m_rayStack.push_back(RayEntry{ node.left + 1, tRight });
+				}
+			}
+			return hit;
+		}
+
+		/** @brief Cost getter
+		*	@return The SAH cost of the tree, relative to the area of the root: after the refits, a build is worth it when
+		*	the cost is much higher than after the last build
+		*/
+		float getCost() const
+		{
+			if (m_nodes.empty())
+				return 0.0f;
+			float rootArea = std::max(m_nodes[0].bounds.getSurfaceArea(), 1e-12f);
+			float cost = 0.0f;
+			for (const Node &node : m_nodes)
+				cost += node.bounds.getSurfaceArea() / rootArea * (node.left == 0 ? (float)node.count : 1.0f);
+			return cost;
+		}
+
+		/** @brief Size getter
+		*	@return The number of primitives
+		*/
+		inline size_t size() const { return m_bounds.size(); }
+
+		/** @brief Node count getter
+		*	@return The number of nodes
+		*/
+		inline size_t getNodeCount() const { return m_nodes.size(); }
+
+		/** @brief Bounds getter
+		*	@param _primitive The id of the primitive
+		*	@return The box of the primitive
+		*/
+		inline const AABB &getBounds(uint32_t _primitive) const { return m_bounds[_primitive]; }
+
+		/** @brief Stats getter
+		*	@return The work of the last query
+		*/
+		inline const Stats &getStats() const { return m_stats; }
+
+	private:
+		struct Node
+		{
+			AABB		bounds;
+			uint32_t	first = 0;	// the primitives of the subtree, in m_primitives
+			uint32_t	count = 0;
+			uint32_t	left = 0;	// the first child (the second follows it), 0 for a leaf
+		};
+
+		struct Bin
+		{
+			AABB		bounds;
+			uint32_t	count = 0;
+		};
+
+		struct StackEntry
+		{
+			uint32_t	node;
+			unsigned	planes;
+		};
+
+		struct RayEntry
+		{
+			uint32_t	node;
+			float		tNear;
+		};
+
+		// the box of a node from its primitives or its children; it returns false if it did not change
+		bool fit(uint32_t _node)
+		{
+			Node &node = m_nodes[_node];
+			AABB bounds;
+			if (node.left == 0)
+			{
+				for (uint32_t i = node.first; i < node.first + node.count; ++i)
+					bounds.expand(m_bounds[m_primitives[i]]);
+			}
+			else
+			{
+				bounds = m_nodes[node.left].bounds;
+				bounds.expand(m_nodes[node.left + 1].bounds);
+			}
+			bool changed = bounds.min != node.bounds.min || bounds.max != node.bounds.max;
+			node.bounds = bounds;
+			return changed;
+		}
+
+		// the node gets its box, and it is split at the best SAH plane (or it becomes a leaf); then its children are split
+		void split(uint32_t _node)
+		{
+			uint32_t first = m_nodes[_node].first, count = m_nodes[_node].count;
+			AABB bounds, centroids;
+			for (uint32_t i = first; i < first + count; ++i)
+			{
+				bounds.expand(m_bounds[m_primitives[i]]);
+				centroids.expand(m_centroids[m_primitives[i]]);
+			}
+			m_nodes[_node].bounds = bounds;
+
+			// the cost of a leaf, and of the best split: the areas are relative to the node, the cost of a traversal step is 1
+			float leafCost = (float)count;
+			float bestCost = leafCost;
+			int bestAxis = -1, bestBin = 0;
+			glm::vec3 extent = centroids.max - centroids.min;
+			if (count > 1)
+			{
+				float area = std::max(bounds.getSurfaceArea(), 1e-12f);
+				for (int axis = 0; axis < 3; ++axis)
+				{
+					if (extent[axis] <= 0.0f)
+						continue;
+					Bin bins[BINS];
+					float scale = BINS / extent[axis];
+					for (uint32_t i = first; i < first + count; ++i)
+					{
+						uint32_t primitive = m_primitives[i];
+						int bin = std::min(BINS - 1, (int)((m_centroids[primitive][axis] - centroids.min[axis]) * scale));
+						bins[bin].bounds.expand(m_bounds[primitive]);
+						++bins[bin].count;
+					}
+					// the areas and the counts on the right of each plane, sweeping from the right
+					float rightArea[BINS - 1];
+					uint32_t rightCount[BINS - 1];
+					AABB right;
+					uint32_t rightSum = 0;
+					for (int i = BINS - 1; i > 0; --i)
+					{
+						right.expand(bins[i].bounds);
+						rightSum += bins[i].count;
+						rightArea[i - 1] = right.getSurfaceArea();
+						rightCount[i - 1] = rightSum;
+					}
+					AABB left;
+					uint32_t leftSum = 0;
+					for (int i = 0; i < BINS - 1; ++i)
+					{
+						left.expand(bins[i].bounds);
+						leftSum += bins[i].count;
+						if (leftSum == 0 || rightCount[i] == 0)
+							continue;
+						float cost = 1.0f + (left.getSurfaceArea() * leftSum + rightArea[i] * rightCount[i]) / area;
+						if (cost < bestCost)
+						{
+							bestCost = cost;
+							bestAxis = axis;
+							bestBin = i;
+						}
+					}
+				}
+			}
+
+			uint32_t middle;
+			if (bestAxis >= 0)
+			{
+				float scale = BINS / extent[bestAxis];
+				float minimum = centroids.min[bestAxis];
+				const std::vector<glm::vec3> &centers = m_centroids;
+				middle = (uint32_t)(std::partition(m_primitives.begin() + first, m_primitives.begin() + first + count,
+					[&](uint32_t _primitive) {
+						return std::min(BINS - 1, (int)((centers[_primitive][bestAxis] - minimum) * scale)) <= bestBin;
+					}) - m_primitives.begin());
+			}
+			else if (count > MAX_LEAF)
+			{
+				// no split is cheaper than the leaf (or the centroids coincide), but the leaf would be too large: we split in the middle
+				int axis = extent.x >= extent.y && extent.x >= extent.z ? 0 : (extent.y >= extent.z ? 1 : 2);
+				middle = first + count / 2;
+				const std::vector<glm::vec3> &centers = m_centroids;
+				std::nth_element(m_primitives.begin() + first, m_primitives.begin() + middle, m_primitives.begin() + first + count,
+					[&](uint32_t _a, uint32_t _b) { return centers[_a][axis] < centers[_b][axis]; });
+			}
+			else
+			{
+				for (uint32_t i = first; i < first + count; ++i)
+					m_leaves[m_primitives[i]] = _node;
+				return;
+			}
+
+			uint32_t left = (uint32_t)m_nodes.size();
+			m_nodes[_node].left = left;
+			m_nodes.push_back(Node());
+			m_nodes.push_back(Node());
+			m_parents.push_back(_node);
+			m_parents.push_back(_node);
+			m_nodes[left].first = first;
+			m_nodes[left].count = middle - first;
+			m_nodes[left + 1].first = middle;
+			m_nodes[left + 1].count = first + count - middle;
+			split(left);
+			split(left + 1);
+		}
+
+		std::vector<Node>		m_nodes;
+		std::vector<uint32_t>	m_parents;		// the parent of each node
+		std::vector<uint32_t>	m_primitives;	// the ids of the primitives, grouped by subtree
+		std::vector<uint32_t>	m_leaves;		// the leaf of each primitive
+		std::vector<AABB>		m_bounds;		// the box of each primitive
+		std::vector<glm::vec3>	m_centroids;	// the centers of the boxes at the build
+		std::vector<uint32_t>	m_dirty;		// the leaves of the primitives changed since the last refit
+		std::vector<StackEntry>	m_stack;
+		std::vector<RayEntry>	m_rayStack;
+		Stats					m_stats;
+	};
+}
@@ -0,0 +1,132 @@
+#pragma once
+
+// cstdlib
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+// external libs
+
+// program
+
+namespace SnowGL
+{
+	/*! @class BenchReport
+	*	@brief Per-frame measurements of a benchmark run, written as JSON
+	*
+	*	The run is described by a list of info values (scenario, backend, renderer...), and the measurements
+	*	by named series with one sample for each recorded frame. Each series is summarized with its
+	*	mean, minimum, maximum and percentiles, so two runs can be compared by a script.
+	*/
+	class BenchReport
+	{
+	public:
+		/** @brief Adds a string to the description of the run
+		*	@param _key The name of the value
+		*	@param _value The value, written as a JSON string
+		*/
+		void setInfo(const std::string &_key, const std::string &_value) { m_info.push_back(std::make_pair(_key, quote(_value))); }
+
+		/** @brief Adds a number to the description of the run
+		*	@param _key The name of the value
+		*	@param _value The value
+		*/
+		void setInfo(const std::string &_key, double _value) { m_info.push_back(std::make_pair(_key, number(_value))); }
+
+		/** @brief Adds a sample to a series (created on the first sample)
+		*	@param _series The name of the series
+		*	@param _value The value measured in the current frame
+		*/
+		void addSample(const std::string &_series, double _value)
+		{
+			for (auto &series : m_series)
+			{
+				if (series.first == _series)
+				{
+					series.second.push_back(_value);
+					return;
+				}
+			}
+			m_series.push_back(std::make_pair(_series, std::vector<double>(1, _value)));
+		}
+
+		/** @brief Percentile of a set of values (nearest rank)
+		*	@param _values The values, sorted
+		*	@param _percentile The percentile, in [0, 100]
+		*	@return The value of the percentile, 0 if there are no values
+		*/
+		static double percentile(const std::vector<double> &_values, double _percentile)
+		{
+			if (_values.empty())
+				return 0.0;
+			size_t rank = (size_t)(_percentile / 100.0 * (_values.size() - 1) + 0.5);
+			return _values[std::min(rank, _values.size() - 1)];
+		}
+
+		/** @brief Writes the report
+		*	@param _filename The JSON file to write
+		*	@return false if the file cannot be written
+		*/
+		bool writeJson(const std::string &_filename) const
+		{
+			std::ofstream file(_filename.c_str(), std::ios::out);
+			if (!file)
+				return false;
+
+			file << "{\n";
+			for (const auto &info : m_info)
+				file << "  " << quote(info.first) << ": " << info.second << ",\n";
+			file << "  \"series\": {";
+			for (size_t i = 0; i < m_series.size(); ++i)
+			{
+				std::vector<double> values = m_series[i].second;
+				std::sort(values.begin(), values.end());
+				double sum = 0.0;
+				for (double value : values)
+					sum += value;
+				file << (i > 0 ? ",\n" : "\n") << "    " << quote(m_series[i].first) << ": { "
+					 << "\"count\": " << values.size()
+					 << ", \"mean\": " << number(sum / values.size())
+					 << ", \"min\": " << number(values.front())
+					 << ", \"p50\": " << number(percentile(values, 50.0))
+					 << ", \"p90\": " << number(percentile(values, 90.0))
+					 << ", \"p95\": " << number(percentile(values, 95.0))
+					 << ", \"p99\": " << number(percentile(values, 99.0))
+					 << ", \"max\": " << number(values.back()) << " }";
+			}
+			file << "\n  }\n}\n";
+			return (bool)file;
+		}
+
+	private:
+		std::vector<std::pair<std::string, std::string>>			m_info;
+		std::vector<std::pair<std::string, std::vector<double>>>	m_series;
+
+		static std::string quote(const std::string &_text)
+		{
+			std::string quoted = "\"";
+			for (char c : _text)
+			{
+				if (c == '"' || c == '\\')
+					quoted += '\\';
+				if ((unsigned char)c >= 0x20)
+					quoted += c;
+			}
+			return quoted + "\"";
+		}
+
+		// JSON has no NaN nor infinity: they are written as null
+		static std::string number(double _value)
+		{
+			if (!std::isfinite(_value))
+				return "null";
+			char buffer[32];
+			snprintf(buffer, sizeof(buffer), "%.6g", _value);
+			return buffer;
+		}
+	};
+}
@@ -0,0 +1,73 @@
+#include "BenchScenario.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+namespace SnowGL
+{
+	bool BenchScenario::fromScenarioFile(const std::string &_filename)
+	{
+		std::ifstream file(_filename.c_str(), std::ios::in);
+		if (!file)
+		{
+			std::cout << "ERROR::BENCHSCENARIO:: unable to open " << _filename << std::endl;
+			return false;
+		}
+
+		bool valid = true;
+		cameraPath.clear();
+		std::string line;
+		int lineNumber = 0;
+		while (std::getline(file, line))
+		{
+			++lineNumber;
+			// comments (";" or "#") are removed, empty lines and [sections] are skipped
+			line = line.substr(0, line.find_first_of(";#"));
+			size_t equal = line.find('=');
+			std::istringstream key(line.substr(0, equal));
+			std::string name;
+			if (!(key >> name) || name[0] == '[')
+				continue;
+			if (equal == std::string::npos)
+			{
+				std::cout << "ERROR::BENCHSCENARIO:: " << _filename << ":" << lineNumber << " missing '='" << std::endl;
+				valid = false;
+				continue;
+			}
+
+			std::istringstream value(line.substr(equal + 1));
+			bool parsed;
+			if (name == "frames")
+				parsed = (bool)(value >> frames) && frames > 0;
+			else if (name == "warmupFrames")
+				parsed = (bool)(value >> warmupFrames) && warmupFrames >= 0;
+			else if (name == "settings")
+				parsed = (bool)(value >> settingsFile);
+			else if (name == "camera")
+			{
+				// camera = time  x y z  yaw pitch
+				CameraKey cameraKey;
+				parsed = (bool)(value >> cameraKey.time >> cameraKey.position.x >> cameraKey.position.y >> cameraKey.position.z
+								>> cameraKey.yaw >> cameraKey.pitch);
+				if (parsed)
+					cameraPath.push_back(cameraKey);
+			}
+			else
+			{
+				std::cout << "WARNING::BENCHSCENARIO:: " << _filename << ":" << lineNumber << " unknown key " << name << std::endl;
+				continue;
+			}
+			if (!parsed)
+			{
+				std::cout << "ERROR::BENCHSCENARIO:: " << _filename << ":" << lineNumber << " invalid value for " << name << std::endl;
+				valid = false;
+			}
+		}
+
+		std::stable_sort(cameraPath.begin(), cameraPath.end(),
+			[](const CameraKey &_a, const CameraKey &_b) { return _a.time < _b.time; });
+		return valid;
+	}
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+// cstdlib
+#include <string>
+#include <vector>
+
+// external libs
+#include <glm/glm.hpp>
+
+// program
+
+namespace SnowGL
+{
+	/*! @class BenchScenario
+	*	@brief Scripted run of the benchmark mode
+	*
+	*	A scenario fixes everything that changes between two runs: the number of frames, the particle
+	*	settings, and the path of the camera. The path is a list of keys (simulation time, position, yaw
+	*	and pitch), linearly interpolated; before the first key and after the last one the camera stands still.
+	*/
+	struct BenchScenario
+	{
+		/*! @struct CameraKey
+		*	@brief Position and orientation of the camera at a given time
+		*/
+		struct CameraKey
+		{
+			float		time;			/**< The simulation time of the key, in seconds */
+			glm::vec3	position;		/**< The position of the camera */
+			float		yaw;			/**< The rotation on the Y axis, in degrees */
+			float		pitch;			/**< The rotation on the X axis, in degrees */
+		};
+
+		int			frames = 600;						/**< The number of recorded frames */
+		int			warmupFrames = 60;					/**< The number of frames run before recording */
+		std::string	settingsFile = "particles.ini";		/**< The particle settings file used by the run */
+		std::vector<CameraKey>	cameraPath;				/**< The keys of the camera path, sorted by time */
+
+		/** @brief Loads the scenario from a .ini file
+		*	@param _filename The scenario file to load
+		*	@return false if the file cannot be opened, or it contains errors
+		*/
+		bool fromScenarioFile(const std::string &_filename);
+
+		/** @brief Camera getter
+		*	@param _time The simulation time
+		*	@return The camera key interpolated at the given time
+		*/
+		CameraKey cameraAt(float _time) const
+		{
+			if (cameraPath.empty())
+				return CameraKey{ _time, glm::vec3(0.0f, 0.0f, 7.0f), -90.0f, 0.0f };
+			if (_time <= cameraPath.front().time)
+				return cameraPath.front();
+			for (size_t i = 1; i < cameraPath.size(); ++i)
+			{
+				const CameraKey &a = cameraPath[i - 1];
+				const CameraKey &b = cameraPath[i];
+				if (_time < b.time)
+				{
+					float t = (_time - a.time) / (b.time - a.time);
+					return CameraKey{ _time, glm::mix(a.position, b.position, t), glm::mix(a.yaw, b.yaw, t), glm::mix(a.pitch, b.pitch, t) };
+				}
+			}
+			return cameraPath.back();
+		}
+	};
+}
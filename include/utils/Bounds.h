@@ -0,0 +1,150 @@
+#pragma once
+
+// cstdlib
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+// external libs
+#include <glm/glm.hpp>
+
+// program
+
+namespace SnowGL
+{
+	/*! @struct AABB
+	*	@brief Axis-aligned bounding box
+	*/
+	struct AABB
+	{
+		glm::vec3 min = glm::vec3(FLT_MAX);		/**< The minimum corner (greater than max while the box is empty) */
+		glm::vec3 max = glm::vec3(-FLT_MAX);	/**< The maximum corner */
+
+		/** @brief Extends the box to contain a point
+		*	@param _point The point
+		*/
+		inline void expand(const glm::vec3 &_point)
+		{
+			min = glm::min(min, _point);
+			max = glm::max(max, _point);
+		}
+
+		/** @brief Extends the box to contain another box
+		*	@param _box The box
+		*/
+		inline void expand(const AABB &_box)
+		{
+			min = glm::min(min, _box.min);
+			max = glm::max(max, _box.max);
+		}
+
+		/** @brief Empty box check
+		*	@return true if the box contains no point
+		*/
+		inline bool isEmpty() const { return min.x > max.x; }
+
+		/** @brief Center getter
+		*	@return The center of the box
+		*/
+		inline glm::vec3 getCenter() const { return 0.5f * (min + max); }
+
+		/** @brief Extents getter
+		*	@return The half size of the box on each axis
+		*/
+		inline glm::vec3 getExtents() const { return 0.5f * (max - min); }
+
+		/** @brief Surface area getter
+		*	@return The area of the faces of the box (0 if it is empty), the cost metric of the BVH build
+		*/
+		inline float getSurfaceArea() const
+		{
+			if (isEmpty())
+				return 0.0f;
+			glm::vec3 size = max - min;
+			return 2.0f * (size.x * size.y + size.y * size.z + size.z * size.x);
+		}
+
+		/** @brief Ray intersection (slab test)
+		*	@param _origin The origin of the ray
+		*	@param _inverseDirection The inverse of each component of the direction of the ray
+		*	@param _tMax The maximum distance along the ray (in units of the direction)
+		*	@param _tNear The distance where the ray enters the box (0 if the origin is inside)
+		*	@return true if the ray hits the box between 0 and _tMax
+		*/
+		inline bool intersectRay(const glm::vec3 &_origin, const glm::vec3 &_inverseDirection, float _tMax, float &_tNear) const
+		{
+			glm::vec3 t0 = (min - _origin) * _inverseDirection;
+			glm::vec3 t1 = (max - _origin) * _inverseDirection;
+			glm::vec3 tMin = glm::min(t0, t1), tMax = glm::max(t0, t1);
+			_tNear = std::max(std::max(tMin.x, tMin.y), std::max(tMin.z, 0.0f));
+			float tFar = std::min(std::min(tMax.x, tMax.y), std::min(tMax.z, _tMax));
+			return _tNear <= tFar;
+		}
+
+		/** @brief Transformed box
+		*	@param _matrix An affine transform
+		*	@return The axis-aligned box containing the transformed box (the extents are transformed by the absolute matrix)
+		*/
+		AABB transformed(const glm::mat4 &_matrix) const
+		{
+			if (isEmpty())
+				return *this;
+			glm::vec3 center = glm::vec3(_matrix * glm::vec4(getCenter(), 1.0f));
+			glm::vec3 extents = getExtents();
+			glm::vec3 size = glm::abs(glm::vec3(_matrix[0])) * extents.x
+				+ glm::abs(glm::vec3(_matrix[1])) * extents.y
+				+ glm::abs(glm::vec3(_matrix[2])) * extents.z;
+			AABB box;
+			box.min = center - size;
+			box.max = center + size;
+			return box;
+		}
+	};
+
+	/*! @struct BoundingSphere
+	*	@brief Bounding sphere
+	*/
+	struct BoundingSphere
+	{
+		glm::vec3 center = glm::vec3(0.0f);	/**< The center */
+		float radius = -1.0f;					/**< The radius (negative while the sphere is empty) */
+
+		/** @brief Sphere containing a set of points, centered in their bounding box
+		*	@param _box The bounding box of the points
+		*	@param _points The first point
+		*	@param _count The number of points
+		*	@param _stride The bytes from a point to the next one
+		*	@return The sphere
+		*/
+		static BoundingSphere fromPoints(const AABB &_box, const glm::vec3 *_points, size_t _count, size_t _stride)
+		{
+			BoundingSphere sphere;
+			if (_box.isEmpty())
+				return sphere;
+			sphere.center = _box.getCenter();
+			float radius2 = 0.0f;
+			const char *point = (const char *)_points;
+			for (size_t i = 0; i < _count; ++i, point += _stride)
+			{
+				glm::vec3 offset = *(const glm::vec3 *)point - sphere.center;
+				radius2 = std::max(radius2, glm::dot(offset, offset));
+			}
+			sphere.radius = std::sqrt(radius2);
+			return sphere;
+		}
+
+		/** @brief Transformed sphere
+		*	@param _matrix An affine transform
+		*	@return The sphere containing the transformed sphere (the radius is scaled by the largest axis scale)
+		*/
+		BoundingSphere transformed(const glm::mat4 &_matrix) const
+		{
+			BoundingSphere sphere;
+			sphere.center = glm::vec3(_matrix * glm::vec4(center, 1.0f));
+			float scale2 = std::max(glm::dot(glm::vec3(_matrix[0]), glm::vec3(_matrix[0])),
+				std::max(glm::dot(glm::vec3(_matrix[1]), glm::vec3(_matrix[1])), glm::dot(glm::vec3(_matrix[2]), glm::vec3(_matrix[2]))));
+			sphere.radius = radius * std::sqrt(scale2);
+			return sphere;
+		}
+	};
+}
@@ -0,0 +1,112 @@
+#pragma once
+
+// cstdlib
+#include <string>
+#include <sys/stat.h>
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <unistd.h>
+#include <cstring>
+#endif
+
+// external libs
+
+// program
+
+namespace SnowGL
+{
+	/*! @class FileWatcher
+	*	@brief Non-blocking check for changes to a file
+	*
+	*	On Linux the directory of the file is watched with inotify (editors often save by renaming a
+	*	new file over the old one, so the file itself is not watched). On the other platforms the
+	*	modification time of the file is polled.
+	*	hasChanged() never blocks: the application calls it once per frame, and applies the changes
+	*	at the frame boundary.
+	*/
+	class FileWatcher
+	{
+	public:
+		/** @brief Constructor
+		*	@param _filename The file to watch
+		*/
+		explicit FileWatcher(const std::string &_filename)
+			: m_filename(_filename)
+		{
+#ifdef __linux__
+			size_t slash = _filename.find_last_of('/');
+			std::string directory = slash == std::string::npos ? "." : _filename.substr(0, slash);
+			m_basename = slash == std::string::npos ? _filename : _filename.substr(slash + 1);
+			m_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+			if (m_fd >= 0)
+				m_wd = inotify_add_watch(m_fd, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE);
+#endif
+			m_lastModified = modificationTime();
+		}
+
+		~FileWatcher()
+		{
+#ifdef __linux__
+			if (m_fd >= 0)
+				close(m_fd);
+#endif
+		}
+
+		FileWatcher(const FileWatcher &) = delete;
+		FileWatcher &operator=(const FileWatcher &) = delete;
+
+		/** @brief Checks if the file has been written since the previous call
+		*	@return true if the file changed
+		*/
+		bool hasChanged()
+		{
+#ifdef __linux__
+			if (m_wd >= 0)
+			{
+				bool changed = false;
+				alignas(struct inotify_event) char buffer[4096];
+				ssize_t length;
+				while ((length = read(m_fd, buffer, sizeof(buffer))) > 0)
+				{
+					for (char *ptr = buffer; ptr < buffer + length;)
+					{
+						const struct inotify_event *event = (const struct inotify_event *)ptr;
+						if (event->len > 0 && strcmp(event->name, m_basename.c_str()) == 0)
+							changed = true;
+						ptr += sizeof(struct inotify_event) + event->len;
+					}
+				}
+				return changed;
+			}
+#endif
+			time_t modified = modificationTime();
+			if (modified == m_lastModified)
+				return false;
+			m_lastModified = modified;
+			return true;
+		}
+
+		/** @brief Filename getter
+		*	@return The watched file
+		*/
+		inline const std::string &getFilename() const { return m_filename; }
+
+	private:
+		std::string m_filename;
+		time_t m_lastModified;
+#ifdef __linux__
+		std::string m_basename;
+		int m_fd = -1;
+		int m_wd = -1;
+#endif
+
+		time_t modificationTime() const
+		{
+			struct stat info;
+			if (stat(m_filename.c_str(), &info) != 0)
+				return 0;
+			return info.st_mtime;
+		}
+	};
+}
@@ -0,0 +1,117 @@
+#pragma once
+
+// cstdlib
+#include <cstddef>
+
+// external libs
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+// program
+
+namespace SnowGL
+{
+	/*! @struct FrameUniformData
+	*	@brief The values of the FrameUniforms block, in the std140 layout declared in the shaders
+	*
+	*	The block must be declared in the same way in every shader which reads it:
+	*	@code
+	*	layout (std140) uniform FrameUniforms {
+	*	    mat4 projectionMatrix;
+	*	    mat4 viewMatrix;
+	*	    vec3 lightVector;
+	*	    float Kd;
+	*	    float alpha;
+	*	    float F0;
+	*	};
+	*	@endcode
+	*/
+	struct FrameUniformData
+	{
+		glm::mat4	projectionMatrix;	/**< Projection matrix of the camera (offset 0) */
+		glm::mat4	viewMatrix;			/**< View matrix of the camera (offset 64) */
+		glm::vec3	lightVector;		/**< Direction of the incoming light, in world coordinates (offset 128) */
+		GLfloat		Kd;					/**< Weight of the diffusive component (offset 140, packed after the vec3) */
+		GLfloat		alpha;				/**< Roughness of the GGX model (offset 144) */
+		GLfloat		F0;					/**< Fresnel reflectance at 0 degrees (offset 148) */
+		GLfloat		padding[2];			/**< The size of a std140 block is rounded up to a multiple of 16 */
+	};
+
+	static_assert(offsetof(FrameUniformData, viewMatrix) == 64, "FrameUniformData does not match the std140 layout");
+	static_assert(offsetof(FrameUniformData, lightVector) == 128, "FrameUniformData does not match the std140 layout");
+	static_assert(offsetof(FrameUniformData, Kd) == 140, "FrameUniformData does not match the std140 layout");
+	static_assert(offsetof(FrameUniformData, F0) == 148, "FrameUniformData does not match the std140 layout");
+	static_assert(sizeof(FrameUniformData) == 160, "FrameUniformData does not match the std140 layout");
+
+	/*! @class FrameUniformBuffer
+	*	@brief The uniform buffer of the values shared by all the programs in a frame
+	*
+	*	The buffer stays bound at BINDING: a program reads it once its FrameUniforms block is attached
+	*	to the binding point (attach(), after the link; OpenGL 4.1 has no binding qualifier in GLSL).
+	*	The values are written once per frame, whatever the number of programs.
+	*/
+	class FrameUniformBuffer
+	{
+	public:
+		static const GLuint BINDING = 0;	/**< The uniform buffer binding point of the FrameUniforms block */
+
+		FrameUniformBuffer() = default;
+		~FrameUniformBuffer() { destroy(); }
+
+		FrameUniformBuffer(const FrameUniformBuffer &) = delete;
+		FrameUniformBuffer &operator=(const FrameUniformBuffer &) = delete;
+
+		/** @brief Creates the buffer and binds it at BINDING
+		*/
+		void create()
+		{
+			destroy();
+			glGenBuffers(1, &m_buffer);
+			glBindBuffer(GL_UNIFORM_BUFFER, m_buffer);
+			glBufferData(GL_UNIFORM_BUFFER, sizeof(FrameUniformData), nullptr, GL_DYNAMIC_DRAW);
+			glBindBuffer(GL_UNIFORM_BUFFER, 0);
+			glBindBufferBase(GL_UNIFORM_BUFFER, BINDING, m_buffer);
+		}
+
+		/** @brief Deletes the buffer
+		*/
+		void destroy()
+		{
+			if (m_buffer == 0)
+				return;
+			glDeleteBuffers(1, &m_buffer);
+			m_buffer = 0;
+		}
+
+		/** @brief Writes the values of the frame
+		*	@param _data The values
+		*/
+		void update(const FrameUniformData &_data)
+		{
+			glBindBuffer(GL_UNIFORM_BUFFER, m_buffer);
+			glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(FrameUniformData), &_data);
+			glBindBuffer(GL_UNIFORM_BUFFER, 0);
+		}
+
+		/** @brief Attaches the FrameUniforms block of a program to BINDING
+		*	@param _program The linked program
+		*	@return false if the program does not use the block
+		*/
+		static bool attach(GLuint _program)
+		{
+			GLuint index = glGetUniformBlockIndex(_program, "FrameUniforms");
+			if (index == GL_INVALID_INDEX)
+				return false;
+			glUniformBlockBinding(_program, index, BINDING);
+			return true;
+		}
+
+		/** @brief Buffer getter
+		*	@return The name of the buffer
+		*/
+		inline GLuint getBuffer() const { return m_buffer; }
+
+	private:
+		GLuint	m_buffer = 0;
+	};
+}
@@ -0,0 +1,231 @@
+#pragma once
+
+// cstdlib
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define SNOWGL_CULL_SSE2
+#endif
+
+// external libs
+#include <glm/glm.hpp>
+
+// program
+#include <utils/Bounds.h>
+
+namespace SnowGL
+{
+	/*! @class SphereSet
+	*	@brief Bounding spheres stored as structure of arrays, to be tested 4 at a time
+	*/
+	class SphereSet
+	{
+	public:
+		std::vector<float> x, y, z, radius;	/**< The centers and the radii */
+
+		/** @brief Adds a sphere
+		*	@param _sphere The sphere
+		*/
+		inline void push(const BoundingSphere &_sphere)
+		{
+			x.push_back(_sphere.center.x);
+			y.push_back(_sphere.center.y);
+			z.push_back(_sphere.center.z);
+			radius.push_back(_sphere.radius);
+		}
+
+		/** @brief Removes the spheres
+		*/
+		inline void clear()
+		{
+			x.clear();
+			y.clear();
+			z.clear();
+			radius.clear();
+		}
+
+		/** @brief Size getter
+		*	@return The number of spheres
+		*/
+		inline size_t size() const { return x.size(); }
+	};
+
+	/*! @class FrustumCuller
+	*	@brief Test of bounding volumes against the view frustum
+	*
+	*	The six planes are extracted from the view-projection matrix (Gribb and Hartmann), and normalized, so the
+	*	distance of a sphere center from a plane is compared with its radius. A sphere is culled only if it is
+	*	entirely outside a plane: the test is conservative near the corners of the frustum.
+	*	The spheres of a SphereSet are tested 4 at a time with SSE2 (when available).
+	*/
+	class FrustumCuller
+	{
+	public:
+		/*! @struct Stats
+		*	@brief The volumes tested since the last resetStats()
+		*/
+		struct Stats
+		{
+			unsigned int tested = 0;	/**< The volumes tested */
+			unsigned int visible = 0;	/**< The volumes inside or intersecting the frustum */
+		};
+
+		/** @brief Sets the frustum
+		*	@param _viewProjection The projection matrix multiplied by the view matrix
+		*/
+		void setViewProjection(const glm::mat4 &_viewProjection)
+		{
+			// the rows of the matrix (glm stores the columns)
+			glm::vec4 row[4];
+			for (int i = 0; i < 4; ++i)
+				row[i] = glm::vec4(_viewProjection[0][i], _viewProjection[1][i], _viewProjection[2][i], _viewProjection[3][i]);
+			m_planes[0] = row[3] + row[0];	// left
+			m_planes[1] = row[3] - row[0];	// right
+			m_planes[2] = row[3] + row[1];	// bottom
+			m_planes[3] = row[3] - row[1];	// top
+			m_planes[4] = row[3] + row[2];	// near
+			m_planes[5] = row[3] - row[2];	// far
+			for (int i = 0; i < 6; ++i)
+				m_planes[i] /= glm::length(glm::vec3(m_planes[i]));
+		}
+
+		/** @brief Tests a sphere
+		*	@param _sphere The sphere, in world coordinates
+		*	@return false if the sphere is outside the frustum
+		*/
+		bool isVisible(const BoundingSphere &_sphere)
+		{
+			++m_stats.tested;
+			for (int i = 0; i < 6; ++i)
+				if (glm::dot(glm::vec3(m_planes[i]), _sphere.center) + m_planes[i].w < -_sphere.radius)
+					return false;
+			++m_stats.visible;
+			return true;
+		}
+
+		/** @brief Tests a box
+		*	@param _box The box, in world coordinates
+		*	@return false if the box is outside the frustum
+		*/
+		bool isVisible(const AABB &_box)
+		{
+			++m_stats.tested;
+			for (int i = 0; i < 6; ++i)
+			{
+				// the corner of the box farthest along the normal of the plane
+				glm::vec3 normal = glm::vec3(m_planes[i]);
+				glm::vec3 corner(normal.x >= 0.0f ? _box.max.x : _box.min.x, normal.y >= 0.0f ? _box.max.y : _box.min.y,
+					normal.z >= 0.0f ? _box.max.z : _box.min.z);
+				if (glm::dot(normal, corner) + m_planes[i].w < 0.0f)
+					return false;
+			}
+			++m_stats.visible;
+			return true;
+		}
+
+		/*! @enum Containment
+		*	@brief The position of a box relative to the frustum
+		*/
+		enum Containment
+		{
+			OUTSIDE,	/**< Entirely outside a plane */
+			INTERSECTS,	/**< Possibly crossing a plane */
+			INSIDE		/**< Inside all the planes */
+		};
+
+		static const unsigned ALL_PLANES = 0x3F;	/**< The plane mask of a box not yet tested */
+
+		/** @brief Classifies a box, for the traversal of a hierarchy (it does not change the stats)
+		*	@param _box The box, in world coordinates
+		*	@param _planes The mask of the planes to test. On return, the planes the box crosses: the children of a box
+		*	need to be tested only against them
+		*	@return The position of the box
+		*/
+		Containment classify(const AABB &_box, unsigned &_planes) const
+		{
+			for (int i = 0; i < 6; ++i)
+			{
+				unsigned bit = 1u << i;
+				if (!(_planes & bit))
+					continue;
+				glm::vec3 normal = glm::vec3(m_planes[i]);
+				glm::vec3 center = _box.getCenter(), extents = _box.getExtents();
+				float distance = glm::dot(normal, center) + m_planes[i].w;
+				float radius = glm::dot(glm::abs(normal), extents);
+				if (distance < -radius)
+					return OUTSIDE;
+				if (distance >= radius)
+					_planes &= ~bit;
+			}
+			return _planes ? INTERSECTS : INSIDE;
+		}
+
+		/** @brief Tests a set of spheres
+		*	@param _spheres The spheres, in world coordinates
+		*	@param _visible The indices of the visible spheres, in increasing order (the vector is cleared first)
+		*	@return The number of visible spheres
+		*/
+		size_t cull(const SphereSet &_spheres, std::vector<uint32_t> &_visible)
+		{
+			_visible.clear();
+			size_t count = _spheres.size();
+			size_t i = 0;
+#ifdef SNOWGL_CULL_SSE2
+			__m128 px[6], py[6], pz[6], pw[6];
+			for (int p = 0; p < 6; ++p)
+			{
+				px[p] = _mm_set1_ps(m_planes[p].x);
+				py[p] = _mm_set1_ps(m_planes[p].y);
+				pz[p] = _mm_set1_ps(m_planes[p].z);
+				pw[p] = _mm_set1_ps(m_planes[p].w);
+			}
+			const __m128 zero = _mm_setzero_ps();
+			for (; i + 4 <= count; i += 4)
+			{
+				__m128 x = _mm_loadu_ps(&_spheres.x[i]);
+				__m128 y = _mm_loadu_ps(&_spheres.y[i]);
+				__m128 z = _mm_loadu_ps(&_spheres.z[i]);
+				__m128 negRadius = _mm_sub_ps(zero, _mm_loadu_ps(&_spheres.radius[i]));
+				__m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+				for (int p = 0; p < 6; ++p)
+				{
+					__m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(px[p], x), _mm_mul_ps(py[p], y)),
+						_mm_add_ps(_mm_mul_ps(pz[p], z), pw[p]));
+					inside = _mm_and_ps(inside, _mm_cmpge_ps(distance, negRadius));
+				}
+				int mask = _mm_movemask_ps(inside);
+				for (int lane = 0; lane < 4; ++lane)
+					if (mask & (1 << lane))
+						_visible.push_back((uint32_t)(i + lane));
+			}
+#endif
+			for (; i < count; ++i)
+			{
+				bool inside = true;
+				for (int p = 0; p < 6 && inside; ++p)
+					inside = m_planes[p].x * _spheres.x[i] + m_planes[p].y * _spheres.y[i] + m_planes[p].z * _spheres.z[i] + m_planes[p].w >= -_spheres.radius[i];
+				if (inside)
+					_visible.push_back((uint32_t)i);
+			}
+			m_stats.tested += (unsigned int)count;
+			m_stats.visible += (unsigned int)_visible.size();
+			return _visible.size();
+		}
+
+		/** @brief Stats getter
+		*	@return The volumes tested since the last resetStats()
+		*/
+		inline const Stats &getStats() const { return m_stats; }
+
+		/** @brief Resets the stats (at the beginning of a frame)
+		*/
+		inline void resetStats() { m_stats = Stats(); }
+
+	private:
+		glm::vec4	m_planes[6];
+		Stats		m_stats;
+	};
+}
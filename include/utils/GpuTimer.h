@@ -0,0 +1,197 @@
+#pragma once
+
+// cstdlib
+#include <deque>
+#include <utility>
+#include <vector>
+
+// external libs
+#include <glad/glad.h>
+
+// program
+
+namespace SnowGL
+{
+	/*! @class GpuTimer
+	*	@brief GPU time of the render passes, measured with timestamp queries and read without stalling
+	*
+	*	Each pass is enclosed by two GL_TIMESTAMP queries (so the passes may overlap or nest). The queries
+	*	of the last FRAMES frames are kept in a ring: at the beginning of a frame, the results of the older
+	*	frames are read only if they are already available, so the CPU never waits for the GPU. The results
+	*	arrive a few frames late, in frame order; if a frame is still pending when its slot of the ring is
+	*	needed again, its results are dropped.
+	*/
+	class GpuTimer
+	{
+	public:
+		/*! @struct FrameTimes
+		*	@brief The GPU times of a frame
+		*/
+		struct FrameTimes
+		{
+			unsigned long long	frame;		/**< The index of the frame (the number of beginFrame() calls before it) */
+			std::vector<double>	passMs;		/**< The time of each pass in milliseconds, 0 if the pass did not run */
+		};
+
+		static const int FRAMES = 4;	/**< The number of frames whose queries can be in flight */
+
+		GpuTimer() = default;
+		~GpuTimer() { destroy(); }
+
+		GpuTimer(const GpuTimer &) = delete;
+		GpuTimer &operator=(const GpuTimer &) = delete;
+
+		/** @brief Creates the queries
+		*	@param _passCount The number of passes
+		*	@param _smoothing The weight of a new frame in the moving averages
+		*/
+		void create(int _passCount, double _smoothing = 0.05)
+		{
+			destroy();
+			m_passCount = _passCount;
+			m_smoothing = _smoothing;
+			m_averages.assign(_passCount, 0.0);
+			for (int i = 0; i < FRAMES; ++i)
+			{
+				Slot &slot = m_slots[i];
+				slot.queries.resize(2 * _passCount);
+				slot.used.assign(_passCount, false);
+				slot.pending = false;
+				glGenQueries(2 * _passCount, slot.queries.data());
+			}
+		}
+
+		/** @brief Deletes the queries, dropping the pending results
+		*/
+		void destroy()
+		{
+			if (m_passCount == 0)
+				return;
+			for (int i = 0; i < FRAMES; ++i)
+				glDeleteQueries(2 * m_passCount, m_slots[i].queries.data());
+			m_passCount = 0;
+			m_results.clear();
+		}
+
+		/** @brief Starts a frame: it collects the results available, and recycles the oldest slot of the ring
+		*/
+		void beginFrame()
+		{
+			collect(false);
+			Slot &slot = m_slots[m_frame % FRAMES];
+			if (slot.pending)
+				++m_droppedFrames;
+			slot.frame = m_frame++;
+			slot.used.assign(m_passCount, false);
+			slot.pending = false;
+		}
+
+		/** @brief Marks the beginning of a pass in the current frame
+		*	@param _pass The index of the pass
+		*/
+		inline void begin(int _pass) { glQueryCounter(currentSlot().queries[2 * _pass], GL_TIMESTAMP); }
+
+		/** @brief Marks the end of a pass in the current frame
+		*	@param _pass The index of the pass
+		*/
+		void end(int _pass)
+		{
+			Slot &slot = currentSlot();
+			glQueryCounter(slot.queries[2 * _pass + 1], GL_TIMESTAMP);
+			slot.used[_pass] = true;
+			slot.pending = true;
+		}
+
+		/** @brief Waits for all the frames in flight and collects their results (at the end of a run)
+		*/
+		inline void finish() { collect(true); }
+
+		/** @brief Takes the oldest result collected and not yet taken
+		*	@param _times The result
+		*	@return false if there are no results
+		*/
+		bool popResult(FrameTimes &_times)
+		{
+			if (m_results.empty())
+				return false;
+			_times = std::move(m_results.front());
+			m_results.pop_front();
+			return true;
+		}
+
+		/** @brief Moving average getter
+		*	@param _pass The index of the pass
+		*	@return The moving average of the time of the pass, in milliseconds
+		*/
+		inline double getAverage(int _pass) const { return m_averages[_pass]; }
+
+		/** @brief Pass count getter
+		*	@return The number of passes
+		*/
+		inline int getPassCount() const { return m_passCount; }
+
+		/** @brief Dropped frames getter
+		*	@return The number of frames whose results were not available when their slot was needed again
+		*/
+		inline unsigned long long getDroppedFrames() const { return m_droppedFrames; }
+
+	private:
+		struct Slot
+		{
+			std::vector<GLuint>	queries;		// begin and end timestamps of each pass
+			std::vector<bool>	used;			// the passes which ran in the frame
+			unsigned long long	frame = 0;
+			bool				pending = false;
+		};
+
+		Slot					m_slots[FRAMES];
+		int						m_passCount = 0;
+		double					m_smoothing = 0.05;
+		unsigned long long		m_frame = 0;
+		unsigned long long		m_droppedFrames = 0;
+		std::vector<double>		m_averages;
+		std::deque<FrameTimes>	m_results;
+
+		inline Slot &currentSlot() { return m_slots[(m_frame + FRAMES - 1) % FRAMES]; }
+
+		// it reads the results of the pending frames, from the oldest; unless _wait is true, it stops at the first frame not completed
+		void collect(bool _wait)
+		{
+			for (int i = 0; i < FRAMES; ++i)
+			{
+				Slot &slot = m_slots[(m_frame + i) % FRAMES];
+				if (!slot.pending)
+					continue;
+				if (!_wait)
+				{
+					// the end timestamp of a pass is written after the begin one: the end ones are enough
+					for (int pass = 0; pass < m_passCount; ++pass)
+					{
+						GLint available = GL_TRUE;
+						if (slot.used[pass])
+							glGetQueryObjectiv(slot.queries[2 * pass + 1], GL_QUERY_RESULT_AVAILABLE, &available);
+						if (!available)
+							return;
+					}
+				}
+
+				FrameTimes times;
+				times.frame = slot.frame;
+				times.passMs.assign(m_passCount, 0.0);
+				for (int pass = 0; pass < m_passCount; ++pass)
+				{
+					if (!slot.used[pass])
+						continue;
+					GLuint64 begin = 0, end = 0;
+					glGetQueryObjectui64v(slot.queries[2 * pass], GL_QUERY_RESULT, &begin);
+					glGetQueryObjectui64v(slot.queries[2 * pass + 1], GL_QUERY_RESULT, &end);
+					times.passMs[pass] = (end - begin) / 1.0e6;
+					// the first result of a pass initializes its average
+					m_averages[pass] += (m_averages[pass] > 0.0 ? m_smoothing : 1.0) * (times.passMs[pass] - m_averages[pass]);
+				}
+				slot.pending = false;
+				m_results.push_back(std::move(times));
+			}
+		}
+	};
+}
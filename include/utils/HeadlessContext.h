@@ -0,0 +1,115 @@
+#pragma once
+
+// cstdlib
+#include <cstring>
+
+// external libs
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+// program
+
+namespace SnowGL
+{
+	/*! @class HeadlessContext
+	*	@brief OpenGL core context without a window, created with EGL
+	*
+	*	The context has no surface (EGL_KHR_surfaceless_context): the application renders into its
+	*	own framebuffer objects. The Mesa surfaceless platform is used when available, so no display
+	*	server is needed; with LIBGL_ALWAYS_SOFTWARE=1 Mesa uses its software rasterizer (llvmpipe).
+	*	It needs libEGL, so it is compiled only in the headless build (RAINSNOW_HEADLESS).
+	*/
+	class HeadlessContext
+	{
+	public:
+		HeadlessContext() = default;
+		~HeadlessContext() { destroy(); }
+
+		HeadlessContext(const HeadlessContext &) = delete;
+		HeadlessContext &operator=(const HeadlessContext &) = delete;
+
+		/** @brief Creates the context and makes it current
+		*	@param _major The major OpenGL version
+		*	@param _minor The minor OpenGL version
+		*	@return false if the display cannot be initialized, or the version is not supported
+		*/
+		bool create(int _major, int _minor)
+		{
+			if (m_display == EGL_NO_DISPLAY && !initDisplay())
+				return false;
+
+			const EGLint contextAttributes[] = {
+				EGL_CONTEXT_MAJOR_VERSION_KHR, _major,
+				EGL_CONTEXT_MINOR_VERSION_KHR, _minor,
+				EGL_CONTEXT_OPENGL_PROFILE_MASK_KHR, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT_KHR,
+				EGL_NONE
+			};
+			m_context = eglCreateContext(m_display, m_config, EGL_NO_CONTEXT, contextAttributes);
+			if (m_context == EGL_NO_CONTEXT)
+				return false;
+			if (!eglMakeCurrent(m_display, EGL_NO_SURFACE, EGL_NO_SURFACE, m_context))
+			{
+				eglDestroyContext(m_display, m_context);
+				m_context = EGL_NO_CONTEXT;
+				return false;
+			}
+			return true;
+		}
+
+		/** @brief Releases the context and the display
+		*/
+		void destroy()
+		{
+			if (m_display == EGL_NO_DISPLAY)
+				return;
+			eglMakeCurrent(m_display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+			if (m_context != EGL_NO_CONTEXT)
+				eglDestroyContext(m_display, m_context);
+			eglTerminate(m_display);
+			m_context = EGL_NO_CONTEXT;
+			m_display = EGL_NO_DISPLAY;
+		}
+
+		/** @brief Loader of the OpenGL functions, to be passed to gladLoadGLLoader
+		*	@param _name The name of the function
+		*	@return The address of the function
+		*/
+		static void *getProcAddress(const char *_name) { return (void *)eglGetProcAddress(_name); }
+
+	private:
+		EGLDisplay	m_display = EGL_NO_DISPLAY;
+		EGLConfig	m_config = nullptr;
+		EGLContext	m_context = EGL_NO_CONTEXT;
+
+		bool initDisplay()
+		{
+			// the surfaceless platform needs no display server; otherwise we use the default display
+			const char *extensions = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+			PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay =
+				(PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+			if (extensions && strstr(extensions, "EGL_MESA_platform_surfaceless") && getPlatformDisplay)
+				m_display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+			if (m_display == EGL_NO_DISPLAY)
+				m_display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+			if (m_display == EGL_NO_DISPLAY || !eglInitialize(m_display, nullptr, nullptr))
+			{
+				m_display = EGL_NO_DISPLAY;
+				return false;
+			}
+
+			const EGLint configAttributes[] = {
+				EGL_SURFACE_TYPE, 0,
+				EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+				EGL_NONE
+			};
+			EGLint count = 0;
+			if (!eglBindAPI(EGL_OPENGL_API) || !eglChooseConfig(m_display, configAttributes, &m_config, 1, &count) || count == 0)
+			{
+				eglTerminate(m_display);
+				m_display = EGL_NO_DISPLAY;
+				return false;
+			}
+			return true;
+		}
+	};
+}
@@ -0,0 +1,205 @@
+#pragma once
+
+// cstdlib
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// external libs
+
+// program
+#include "Profiler.h"
+
+namespace SnowGL
+{
+	/*! @class JobPool
+	*	@brief A pool of worker threads with work stealing, used to split loops in fixed-size chunks
+	*
+	*	Every worker owns a queue of chunks: it takes work from the back of its own queue and, when
+	*	that is empty, steals from the front of the queues of the other workers. The thread calling
+	*	parallelFor() owns a queue too and works until the whole loop is completed.
+	*	The chunk boundaries depend only on the loop size and on the chunk size, never on the number
+	*	of threads, so a loop whose iterations are independent gives the same result on any machine.
+	*/
+	class JobPool
+	{
+	public:
+		/** @brief Loop body: it receives the range [begin, end) of one chunk */
+		typedef std::function<void(size_t, size_t)> RangeFunction;
+
+		/** @brief Starts the workers
+		*	@param _threads The number of threads working on a loop, caller included (0 = one for each hardware thread)
+		*/
+		explicit JobPool(unsigned _threads = 0)
+			: m_queued(0), m_stop(false)
+		{
+			if (_threads == 0)
+				_threads = std::thread::hardware_concurrency();
+			if (_threads == 0)
+				_threads = 1;
+
+			for (unsigned i = 0; i < _threads; ++i)
+				m_queues.emplace_back(new Queue());
+			// the last queue belongs to the thread calling parallelFor()
+			for (unsigned i = 0; i + 1 < _threads; ++i)
+				m_workers.emplace_back(&JobPool::workerLoop, this, i);
+		}
+
+		~JobPool()
+		{
+			{
+				std::lock_guard<std::mutex> lock(m_wakeMutex);
+				m_stop = true;
+			}
+			m_wake.notify_all();
+			for (size_t i = 0; i < m_workers.size(); ++i)
+				m_workers[i].join();
+		}
+
+		JobPool(const JobPool &) = delete;
+		JobPool &operator=(const JobPool &) = delete;
+
+		/** @brief Thread count getter
+		*	@return The number of threads working on a loop, caller included
+		*/
+		inline unsigned getThreadCount() const { return (unsigned)m_queues.size(); }
+
+		/** @brief Runs a loop on the pool, and returns when every chunk has been processed
+		*	@param _count The number of iterations
+		*	@param _chunkSize The number of iterations in each chunk
+		*	@param _function The loop body, called once for each chunk
+		*/
+		void parallelFor(size_t _count, size_t _chunkSize, const RangeFunction &_function)
+		{
+			if (_count == 0)
+				return;
+			if (_chunkSize == 0)
+				_chunkSize = _count;
+
+			size_t numChunks = (_count + _chunkSize - 1) / _chunkSize;
+			if (numChunks == 1 || m_queues.size() == 1)
+			{
+				for (size_t begin = 0; begin < _count; begin += _chunkSize)
+					_function(begin, begin + _chunkSize < _count ? begin + _chunkSize : _count);
+				return;
+			}
+
+			std::atomic<size_t> pending(numChunks);
+			// chunks are dealt in contiguous blocks, so each thread starts on neighbouring memory
+			size_t perQueue = (numChunks + m_queues.size() - 1) / m_queues.size();
+			for (size_t c = 0; c < numChunks; ++c)
+			{
+				Task task;
+				task.function = &_function;
+				task.begin = c * _chunkSize;
+				task.end = task.begin + _chunkSize < _count ? task.begin + _chunkSize : _count;
+				task.pending = &pending;
+
+				Queue &queue = *m_queues[c / perQueue];
+				std::lock_guard<std::mutex> lock(queue.mutex);
+				queue.tasks.push_front(task);
+			}
+			m_queued += numChunks;
+			{
+				std::lock_guard<std::mutex> lock(m_wakeMutex);
+			}
+			m_wake.notify_all();
+
+			// the caller works too, until no chunk is left to take
+			unsigned self = (unsigned)m_queues.size() - 1;
+			Task task;
+			while (pending.load() > 0)
+			{
+				if (takeTask(self, task))
+					runTask(task);
+				else
+					std::this_thread::yield();
+			}
+		}
+
+	private:
+		struct Task
+		{
+			const RangeFunction *function;
+			size_t begin;
+			size_t end;
+			std::atomic<size_t> *pending;
+		};
+
+		struct Queue
+		{
+			std::mutex mutex;
+			std::deque<Task> tasks;
+		};
+
+		std::vector<std::unique_ptr<Queue>> m_queues;
+		std::vector<std::thread> m_workers;
+		std::atomic<size_t> m_queued;
+
+		std::mutex m_wakeMutex;
+		std::condition_variable m_wake;
+		bool m_stop;
+
+		// own queue first (from the back), then steal from the others (from the front)
+		bool takeTask(unsigned _self, Task &_task)
+		{
+			if (m_queued.load() == 0)
+				return false;
+			{
+				Queue &own = *m_queues[_self];
+				std::lock_guard<std::mutex> lock(own.mutex);
+				if (!own.tasks.empty())
+				{
+					_task = own.tasks.back();
+					own.tasks.pop_back();
+					--m_queued;
+					return true;
+				}
+			}
+			for (size_t i = 1; i < m_queues.size(); ++i)
+			{
+				Queue &victim = *m_queues[(_self + i) % m_queues.size()];
+				std::lock_guard<std::mutex> lock(victim.mutex);
+				if (!victim.tasks.empty())
+				{
+					_task = victim.tasks.front();
+					victim.tasks.pop_front();
+					--m_queued;
+					return true;
+				}
+			}
+			return false;
+		}
+
+		static void runTask(const Task &_task)
+		{
+			SNOWGL_PROFILE_SCOPE("JobPool chunk");
+			(*_task.function)(_task.begin, _task.end);
+			--(*_task.pending);
+		}
+
+		void workerLoop(unsigned _self)
+		{
+			Profiler::setThreadName("worker " + std::to_string(_self));
+			Task task;
+			for (;;)
+			{
+				if (takeTask(_self, task))
+				{
+					runTask(task);
+					continue;
+				}
+				std::unique_lock<std::mutex> lock(m_wakeMutex);
+				m_wake.wait(lock, [this] { return m_stop || m_queued.load() > 0; });
+				if (m_stop)
+					return;
+			}
+		}
+	};
+}
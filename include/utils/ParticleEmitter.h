@@ -0,0 +1,92 @@
+#pragma once
+
+// cstdlib
+#include <cstddef>
+
+// external libs
+
+// program
+#include "ParticleSettings.h"
+#include "ParticleStore.h"
+
+namespace SnowGL
+{
+	/*! @class ParticleEmitter
+	*	@brief Emits particles at the rate given by a ParticleSettings
+	*
+	*	The emitter converts ParticleSettings::particlesPerSecond in a number of particles for each
+	*	simulation step, carrying the fractional part over to the next step, and it gives each new
+	*	particle a lifetime in [lifetimeMin, lifetimeMax].
+	*	The settings are referenced, not copied: changes to them apply from the next emit().
+	*/
+	class ParticleEmitter
+	{
+	public:
+		/** @brief Constructor
+		*	@param _settings The settings to honour, which must outlive the emitter
+		*/
+		explicit ParticleEmitter(const ParticleSettings &_settings) : m_settings(_settings) {}
+
+		/** @brief Counts the particles to emit after a simulation step
+		*	@param _dt The length of the step, in seconds
+		*	@return The number of particles due in the step
+		*/
+		size_t emit(float _dt)
+		{
+			m_accumulator += m_settings.particlesPerSecond * _dt;
+			if (m_accumulator < 0.0)
+				m_accumulator = 0.0;
+			size_t count = (size_t)m_accumulator;
+			m_accumulator -= (double)count;
+			m_emitted += count;
+			return count;
+		}
+
+		/** @brief Emits the particles due after a simulation step into a store
+		*	@param _dt The length of the step, in seconds
+		*	@param _store The store receiving the particles
+		*	@param _init Called as _init(first, count, serial) to initialise the new particles, which are in the
+		*				 slots [first, first + count). serial is the emission number of the first one, a unique
+		*				 id to use as counter for the random values
+		*	@return The number of spawned particles (less than the due ones if the store is full)
+		*/
+		template <class InitFunction>
+		size_t emit(float _dt, ParticleStore &_store, InitFunction _init)
+		{
+			size_t count = emit(_dt);
+			size_t first;
+			size_t spawned = _store.spawn(count, first);
+			m_dropped += count - spawned;
+			if (spawned > 0)
+				_init(first, spawned, m_emitted - count);
+			return spawned;
+		}
+
+		/** @brief Maps a uniform random value to a lifetime
+		*	@param _u A random value in [0, 1]
+		*	@return A lifetime in [lifetimeMin, lifetimeMax], in seconds
+		*/
+		inline float lifetime(float _u) const { return m_settings.lifetimeMin + (m_settings.lifetimeMax - m_settings.lifetimeMin) * _u; }
+
+		/** @brief Emitted count getter
+		*	@return The number of particles emitted since the construction
+		*/
+		inline size_t getEmittedCount() const { return m_emitted; }
+
+		/** @brief Dropped count getter
+		*	@return The number of particles not spawned because the store was full
+		*/
+		inline size_t getDroppedCount() const { return m_dropped; }
+
+		/** @brief Settings getter
+		*	@return The settings honoured by the emitter
+		*/
+		inline const ParticleSettings &getSettings() const { return m_settings; }
+
+	private:
+		const ParticleSettings	&m_settings;
+		double					m_accumulator = 0.0;
+		size_t					m_emitted = 0;
+		size_t					m_dropped = 0;
+	};
+}
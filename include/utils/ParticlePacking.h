@@ -0,0 +1,102 @@
+#pragma once
+
+// cstdlib
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+// external libs
+#include <glm/glm.hpp>
+
+// program
+
+namespace SnowGL
+{
+	/*! @class ParticlePacking
+	*	@brief CPU side of the packed particle format decoded by particles_shader.vert (PACKED_PARTICLES)
+	*
+	*	A packed particle state is 4 unsigned integers (16 bytes, instead of 28 for the float format):
+	*	- x: position x and y, unorm16 relative to the particle domain
+	*	- y: position z (unorm16, low half) and velocity x (half float, high half)
+	*	- z: velocity y and z, half floats
+	*	- w: start time, 32 bit float (absolute simulation time needs the full precision)
+	*	The initial velocity is 3 half floats in 2 unsigned integers (8 bytes, instead of 12).
+	*	The domain is the box of size domainSize centred in domainPosition: positions outside are clamped.
+	*	The conversions match the shader ones: halves are rounded to nearest, and denormals flushed to zero.
+	*/
+	class ParticlePacking
+	{
+	public:
+		/** @brief Converts a float to a half float
+		*	@param _value The value to convert
+		*	@return The bits of the half float
+		*/
+		static uint16_t toHalf(float _value)
+		{
+			uint32_t x;
+			memcpy(&x, &_value, sizeof(x));
+			uint32_t sign = (x >> 16) & 0x8000u;
+			int exponent = (int)((x >> 23) & 0xffu) - 127 + 15;
+			uint32_t mantissa = x & 0x7fffffu;
+			if (exponent <= 0)
+				return (uint16_t)sign;
+			if (exponent >= 31)
+				return (uint16_t)(sign | 0x7bffu);
+			// the rounding carry may overflow in the exponent, which is the correct result, except from the largest exponent
+			// to infinity: it is clamped to the largest finite half, like the values out of range
+			uint32_t bits = ((uint32_t)exponent << 10) + ((mantissa + 0x1000u) >> 13);
+			return (uint16_t)(sign | std::min(bits, 0x7bffu));
+		}
+
+		/** @brief Converts a half float to a float
+		*	@param _bits The bits of the half float
+		*	@return The converted value
+		*/
+		static float fromHalf(uint16_t _bits)
+		{
+			uint32_t sign = (uint32_t)(_bits & 0x8000u) << 16;
+			uint32_t exponent = (_bits >> 10) & 0x1fu;
+			uint32_t mantissa = _bits & 0x3ffu;
+			uint32_t x = exponent == 0 ? sign : sign | ((exponent + 112u) << 23) | (mantissa << 13);
+			float value;
+			memcpy(&value, &x, sizeof(value));
+			return value;
+		}
+
+		/** @brief Converts a value in [0, 1] to unorm16
+		*	@param _value The value to convert, clamped to [0, 1]
+		*	@return The unorm16 value
+		*/
+		static inline uint16_t toUnorm16(float _value) { return (uint16_t)(glm::clamp(_value, 0.0f, 1.0f) * 65535.0f + 0.5f); }
+
+		/** @brief Packs a particle state
+		*	@param _position The position of the particle
+		*	@param _velocity The velocity of the particle
+		*	@param _startTime The emission time of the particle
+		*	@param _domainMin The lower corner of the particle domain
+		*	@param _domainSize The size of the particle domain
+		*	@param _out The 4 packed values
+		*/
+		static void packState(const glm::vec3 &_position, const glm::vec3 &_velocity, float _startTime,
+							  const glm::vec3 &_domainMin, const glm::vec3 &_domainSize, uint32_t _out[4])
+		{
+			glm::vec3 p = (_position - _domainMin) / _domainSize;
+			uint32_t time;
+			memcpy(&time, &_startTime, sizeof(time));
+			_out[0] = toUnorm16(p.x) | ((uint32_t)toUnorm16(p.y) << 16);
+			_out[1] = toUnorm16(p.z) | ((uint32_t)toHalf(_velocity.x) << 16);
+			_out[2] = toHalf(_velocity.y) | ((uint32_t)toHalf(_velocity.z) << 16);
+			_out[3] = time;
+		}
+
+		/** @brief Packs a velocity in 3 half floats
+		*	@param _velocity The velocity to pack
+		*	@param _out The 2 packed values (the high half of the second one is zero)
+		*/
+		static void packVelocity(const glm::vec3 &_velocity, uint32_t _out[2])
+		{
+			_out[0] = toHalf(_velocity.x) | ((uint32_t)toHalf(_velocity.y) << 16);
+			_out[1] = toHalf(_velocity.z);
+		}
+	};
+}
@@ -0,0 +1,340 @@
+#pragma once
+
+// cstdlib
+#include <cstddef>
+#include <cstring>
+#include <vector>
+
+// external libs
+#include <glad/glad.h>
+
+// program
+
+namespace SnowGL
+{
+	/*! @class ParticlePool
+	*	@brief GPU storage of the transform feedback particle system, growing geometrically
+	*
+	*	The pool owns the buffers of the particle attributes (streams). The streams written by the
+	*	update pass are doubled for ping-ponging, the others are shared by both sets. Each set has its
+	*	vertex array (the attribute location is the index of the stream in the layout) and its
+	*	transform feedback object.
+	*	In the separate layout every stream has its own buffer, and the binding index of a ping-pong
+	*	stream is its order among the ping-pong ones (GL_SEPARATE_ATTRIBS). In the interleaved layout
+	*	all the ping-pong streams of a set share one buffer, in the order of the layout, bound at
+	*	index 0 (GL_INTERLEAVED_ATTRIBS).
+	*	Without ping-pong streams (e.g. when a compute shader updates the particles in place) there is
+	*	a single set: set 1 is the same as set 0, and no feedback object is created.
+	*	When more particles than the capacity are requested, every buffer is reallocated at twice the
+	*	capacity: the slots in use are copied on the GPU with glCopyBufferSubData, and the vertex arrays
+	*	and feedback objects are bound to the new buffers. Shrinking never reallocates.
+	*	A GL context must be current for every method, and create() must be called first.
+	*/
+	class ParticlePool
+	{
+	public:
+		/*! @struct Stream
+		*	@brief Description of a particle attribute
+		*/
+		struct Stream
+		{
+			GLint		components;		/**< Number of components (1 to 4) */
+			GLenum		type;			/**< Component type (GL_FLOAT, GL_UNSIGNED_INT, ...) */
+			bool		pingPong;		/**< true if the attribute is written by the update pass */
+		};
+
+		/** @brief Growth factor of the capacity */
+		static const size_t GROWTH = 2;
+
+		ParticlePool() {}
+		~ParticlePool() { destroy(); }
+
+		ParticlePool(const ParticlePool &) = delete;
+		ParticlePool &operator=(const ParticlePool &) = delete;
+
+		/** @brief Creates the buffers, vertex arrays and feedback objects
+		*	@param _layout The particle attributes
+		*	@param _count The number of particles in use
+		*	@param _interleaved true to store all the ping-pong streams of a set in a single buffer
+		*
+		*	The content of the buffers is undefined: the caller has to fill the slots [0, _count).
+		*/
+		void create(const std::vector<Stream> &_layout, size_t _count, bool _interleaved = false)
+		{
+			destroy();
+			m_layout = _layout;
+			m_interleaved = _interleaved;
+			m_count = _count;
+			m_capacity = _count > 0 ? _count : 1;
+
+			// the streams are assigned to their buffers
+			m_streamBuffer.resize(m_layout.size());
+			m_streamOffset.resize(m_layout.size());
+			int interleavedBuffer = -1;
+			for (size_t s = 0; s < m_layout.size(); ++s)
+			{
+				if (m_interleaved && m_layout[s].pingPong && interleavedBuffer >= 0)
+				{
+					Buffer &buffer = m_buffers[interleavedBuffer];
+					m_streamBuffer[s] = interleavedBuffer;
+					m_streamOffset[s] = buffer.stride;
+					buffer.stride += getStreamSize(s);
+					continue;
+				}
+				Buffer buffer;
+				buffer.stride = getStreamSize(s);
+				buffer.pingPong = m_layout[s].pingPong;
+				m_streamBuffer[s] = (int)m_buffers.size();
+				m_streamOffset[s] = 0;
+				if (m_interleaved && m_layout[s].pingPong)
+					interleavedBuffer = (int)m_buffers.size();
+				m_buffers.push_back(buffer);
+			}
+
+			m_sets = 1;
+			for (size_t b = 0; b < m_buffers.size(); ++b)
+			{
+				m_buffers[b].names[0] = allocate(m_buffers[b], m_capacity);
+				m_buffers[b].names[1] = m_buffers[b].pingPong ? allocate(m_buffers[b], m_capacity) : m_buffers[b].names[0];
+				if (m_buffers[b].pingPong)
+					m_sets = 2;
+			}
+			glGenVertexArrays(m_sets, m_vertexArrays);
+			if (m_sets == 2)
+				glGenTransformFeedbacks(2, m_feedbacks);
+			bindSets();
+		}
+
+		/** @brief Deletes every GL object of the pool */
+		void destroy()
+		{
+			if (m_buffers.empty())
+				return;
+			for (size_t b = 0; b < m_buffers.size(); ++b)
+			{
+				glDeleteBuffers(1, &m_buffers[b].names[0]);
+				if (m_buffers[b].pingPong)
+					glDeleteBuffers(1, &m_buffers[b].names[1]);
+			}
+			glDeleteVertexArrays(m_sets, m_vertexArrays);
+			if (m_sets == 2)
+				glDeleteTransformFeedbacks(2, m_feedbacks);
+			m_feedbacks[0] = m_feedbacks[1] = 0;
+			m_buffers.clear();
+			m_count = m_capacity = 0;
+		}
+
+		/** @brief Changes the number of particles in use
+		*	@param _count The new number of particles
+		*	@return true if the buffers have been reallocated (the buffer names have changed)
+		*
+		*	The slots [0, min(old count, _count)) keep their content; the caller has to fill the new ones.
+		*/
+		bool resize(size_t _count)
+		{
+			bool grown = false;
+			if (_count > m_capacity)
+			{
+				size_t capacity = m_capacity * GROWTH;
+				grow(capacity > _count ? capacity : _count);
+				grown = true;
+			}
+			m_count = _count;
+			return grown;
+		}
+
+		/** @brief Writes the values of a stream for a range of particles, in both sets
+		*	@param _stream The index of the stream in the layout
+		*	@param _first The first particle to write
+		*	@param _count The number of particles to write
+		*	@param _data _count tightly packed values of the stream
+		*/
+		void write(size_t _stream, size_t _first, size_t _count, const void *_data)
+		{
+			const Buffer &buffer = m_buffers[m_streamBuffer[_stream]];
+			GLsizei size = getStreamSize(_stream);
+			GLsizei offset = m_streamOffset[_stream];
+			for (int set = 0; set < (buffer.pingPong ? 2 : 1); ++set)
+			{
+				glBindBuffer(GL_ARRAY_BUFFER, buffer.names[set]);
+				if (buffer.stride == size)
+				{
+					glBufferSubData(GL_ARRAY_BUFFER, _first * size, _count * size, _data);
+					continue;
+				}
+				// interleaved: the records are mapped without invalidation, so the other streams are preserved
+				char *records = (char *)glMapBufferRange(GL_ARRAY_BUFFER, _first * buffer.stride, _count * buffer.stride, GL_MAP_WRITE_BIT);
+				if (!records)
+					continue;
+				for (size_t i = 0; i < _count; ++i)
+					memcpy(records + i * buffer.stride + offset, (const char *)_data + i * size, size);
+				glUnmapBuffer(GL_ARRAY_BUFFER);
+			}
+			glBindBuffer(GL_ARRAY_BUFFER, 0);
+		}
+
+		/** @brief Buffer getter
+		*	@param _stream The index of the stream in the layout
+		*	@param _set The ping-pong set (0 or 1), ignored for the streams not written by the update pass
+		*	@return The buffer holding the stream
+		*/
+		inline GLuint getBuffer(size_t _stream, int _set) const { return m_buffers[m_streamBuffer[_stream]].names[_set]; }
+
+		/** @brief Vertex array getter
+		*	@param _set The ping-pong set (0 or 1)
+		*	@return The vertex array reading the set
+		*/
+		inline GLuint getVertexArray(int _set) const { return m_vertexArrays[_set % m_sets]; }
+
+		/** @brief Transform feedback getter
+		*	@param _set The ping-pong set (0 or 1)
+		*	@return The feedback object writing the set (0 without ping-pong streams)
+		*/
+		inline GLuint getFeedback(int _set) const { return m_feedbacks[_set]; }
+
+		/** @brief Stream count getter
+		*	@return The number of streams in the layout
+		*/
+		inline size_t getStreamCount() const { return m_layout.size(); }
+
+		/** @brief Layout getter
+		*	@return true if the ping-pong streams are interleaved in a single buffer
+		*/
+		inline bool isInterleaved() const { return m_interleaved; }
+
+		/** @brief Particle count getter
+		*	@return The number of particles in use
+		*/
+		inline size_t getCount() const { return m_count; }
+
+		/** @brief Capacity getter
+		*	@return The number of particles the buffers can hold without reallocating
+		*/
+		inline size_t getCapacity() const { return m_capacity; }
+
+		/** @brief Reserved memory getter
+		*	@return The bytes allocated by all the buffers
+		*/
+		inline size_t getReservedBytes() const { return m_capacity * getBytesPerParticle(); }
+
+		/** @brief Used memory getter
+		*	@return The bytes of all the buffers holding particles in use
+		*/
+		inline size_t getUsedBytes() const { return m_count * getBytesPerParticle(); }
+
+		/** @brief Memory getter
+		*	@return The bytes of a particle, summed over every buffer (ping-pong copies included)
+		*/
+		size_t getBytesPerParticle() const
+		{
+			size_t bytes = 0;
+			for (size_t b = 0; b < m_buffers.size(); ++b)
+				bytes += m_buffers[b].stride * (m_buffers[b].pingPong ? 2 : 1);
+			return bytes;
+		}
+
+		/** @brief Stream size getter
+		*	@param _stream The index of the stream in the layout
+		*	@return The bytes of a particle in the stream
+		*/
+		inline GLsizei getStreamSize(size_t _stream) const { return m_layout[_stream].components * componentSize(m_layout[_stream].type); }
+
+	private:
+		struct Buffer
+		{
+			GLuint		names[2] = { 0, 0 };	/**< The same name twice for the shared buffers */
+			GLsizei		stride = 0;
+			bool		pingPong = false;
+		};
+
+		std::vector<Stream>		m_layout;
+		std::vector<Buffer>		m_buffers;
+		std::vector<int>		m_streamBuffer;		/**< Index of the buffer of each stream */
+		std::vector<GLsizei>	m_streamOffset;		/**< Byte offset of each stream in the records of its buffer */
+		bool					m_interleaved = false;
+		int						m_sets = 2;
+		GLuint					m_vertexArrays[2] = { 0, 0 };
+		GLuint					m_feedbacks[2] = { 0, 0 };
+		size_t					m_count = 0;
+		size_t					m_capacity = 0;
+
+		static GLsizei componentSize(GLenum _type)
+		{
+			switch (_type)
+			{
+			case GL_BYTE: case GL_UNSIGNED_BYTE: return 1;
+			case GL_SHORT: case GL_UNSIGNED_SHORT: case GL_HALF_FLOAT: return 2;
+			default: return 4;
+			}
+		}
+
+		static GLuint allocate(const Buffer &_buffer, size_t _capacity)
+		{
+			GLuint name;
+			glGenBuffers(1, &name);
+			glBindBuffer(GL_ARRAY_BUFFER, name);
+			glBufferData(GL_ARRAY_BUFFER, _capacity * _buffer.stride, NULL, _buffer.pingPong ? GL_DYNAMIC_COPY : GL_STATIC_DRAW);
+			glBindBuffer(GL_ARRAY_BUFFER, 0);
+			return name;
+		}
+
+		// the slots in use are copied in new buffers, without reading them back on the CPU
+		void grow(size_t _capacity)
+		{
+			for (size_t b = 0; b < m_buffers.size(); ++b)
+			{
+				Buffer &buffer = m_buffers[b];
+				int sets = buffer.pingPong ? 2 : 1;
+				for (int set = 0; set < sets; ++set)
+				{
+					GLuint grown = allocate(buffer, _capacity);
+					glBindBuffer(GL_COPY_READ_BUFFER, buffer.names[set]);
+					glBindBuffer(GL_COPY_WRITE_BUFFER, grown);
+					glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, m_count * buffer.stride);
+					glDeleteBuffers(1, &buffer.names[set]);
+					buffer.names[set] = grown;
+				}
+				if (sets == 1)
+					buffer.names[1] = buffer.names[0];
+			}
+			glBindBuffer(GL_COPY_READ_BUFFER, 0);
+			glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+			m_capacity = _capacity;
+			bindSets();
+		}
+
+		// the vertex arrays and the feedback objects are bound to the current buffers
+		void bindSets()
+		{
+			for (int set = 0; set < m_sets; ++set)
+			{
+				glBindVertexArray(m_vertexArrays[set]);
+				for (size_t s = 0; s < m_layout.size(); ++s)
+				{
+					const Stream &stream = m_layout[s];
+					const Buffer &buffer = m_buffers[m_streamBuffer[s]];
+					const GLvoid *offset = (const GLvoid *)(size_t)m_streamOffset[s];
+					glBindBuffer(GL_ARRAY_BUFFER, buffer.names[set]);
+					if (stream.type == GL_FLOAT || stream.type == GL_HALF_FLOAT)
+						glVertexAttribPointer((GLuint)s, stream.components, stream.type, GL_FALSE, buffer.stride, offset);
+					else
+						glVertexAttribIPointer((GLuint)s, stream.components, stream.type, buffer.stride, offset);
+					glEnableVertexAttribArray((GLuint)s);
+				}
+
+				if (m_sets == 1)
+					continue;
+				glBindTransformFeedback(GL_TRANSFORM_FEEDBACK, m_feedbacks[set]);
+				GLuint binding = 0;
+				for (size_t b = 0; b < m_buffers.size(); ++b)
+				{
+					if (m_buffers[b].pingPong)
+						glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, binding++, m_buffers[b].names[set]);
+				}
+			}
+			glBindVertexArray(0);
+			glBindTransformFeedback(GL_TRANSFORM_FEEDBACK, 0);
+			glBindBuffer(GL_ARRAY_BUFFER, 0);
+		}
+	};
+}
@@ -0,0 +1,155 @@
+#pragma once
+
+// cstdlib
+#include <cstddef>
+#include <cstdint>
+
+// external libs
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define SNOWGL_RANDOM_SSE2
+#endif
+
+// program
+
+namespace SnowGL
+{
+	/*! @class ParticleRandom
+	*	@brief Counter-based random generator (Philox4x32-10) for particle seeding
+	*
+	*	The generator has no state: every call hashes a counter (particle index, frame) with the key
+	*	(seed, stream) and returns 4 independent 32 bit values. The same particle in the same frame
+	*	always gets the same values, whatever the order or the thread in which particles are spawned,
+	*	so spawning can run in parallel and stays reproducible from a single seed.
+	*	See Salmon et al., "Parallel random numbers: as easy as 1, 2, 3", SC 2011.
+	*/
+	class ParticleRandom
+	{
+	public:
+		/** @brief Constructor
+		*	@param _seed The seed of the sequence
+		*	@param _stream An independent sequence for the same seed (e.g. one for each emitter)
+		*/
+		explicit ParticleRandom(uint32_t _seed = 0, uint32_t _stream = 0) : m_key0(_seed), m_key1(_stream) {}
+
+		/** @brief Generates 4 random integers
+		*	@param _index The particle index
+		*	@param _frame The frame (or simulation step) of the spawn
+		*	@param _out The 4 generated values
+		*/
+		void generate(uint32_t _index, uint32_t _frame, uint32_t _out[4]) const
+		{
+			uint32_t c0 = _index, c1 = _frame, c2 = 0, c3 = 0;
+			uint32_t k0 = m_key0, k1 = m_key1;
+			for (int round = 0; round < ROUNDS; ++round)
+			{
+				uint64_t p0 = (uint64_t)M0 * c0;
+				uint64_t p1 = (uint64_t)M1 * c2;
+				uint32_t hi0 = (uint32_t)(p0 >> 32), lo0 = (uint32_t)p0;
+				uint32_t hi1 = (uint32_t)(p1 >> 32), lo1 = (uint32_t)p1;
+				c0 = hi1 ^ c1 ^ k0;
+				c1 = lo1;
+				c2 = hi0 ^ c3 ^ k1;
+				c3 = lo0;
+				k0 += W0;
+				k1 += W1;
+			}
+			_out[0] = c0;
+			_out[1] = c1;
+			_out[2] = c2;
+			_out[3] = c3;
+		}
+
+		/** @brief Generates 4 random floats
+		*	@param _index The particle index
+		*	@param _frame The frame (or simulation step) of the spawn
+		*	@param _out The 4 generated values, in [0, 1)
+		*/
+		void uniform(uint32_t _index, uint32_t _frame, float _out[4]) const
+		{
+			uint32_t bits[4];
+			generate(_index, _frame, bits);
+			for (int i = 0; i < 4; ++i)
+				_out[i] = toFloat(bits[i]);
+		}
+
+		/** @brief Generates 4 random floats for each particle in a range of indices
+		*	@param _first The index of the first particle
+		*	@param _count The number of particles
+		*	@param _frame The frame (or simulation step) of the spawn
+		*	@param _out0, _out1, _out2, _out3 Streams of _count values in [0, 1), one for each output of the generator
+		*
+		*	It gives the same values as calling uniform() for each index, 4 particles at a time with SSE2.
+		*/
+		void uniformBatch(uint32_t _first, size_t _count, uint32_t _frame, float *_out0, float *_out1, float *_out2, float *_out3) const
+		{
+			size_t i = 0;
+#ifdef SNOWGL_RANDOM_SSE2
+			const __m128i m0 = _mm_set1_epi32((int)M0);
+			const __m128i m1 = _mm_set1_epi32((int)M1);
+			const __m128i lane = _mm_set_epi32(3, 2, 1, 0);
+			const __m128 scale = _mm_set1_ps(1.0f / 16777216.0f);
+			for (; i + 4 <= _count; i += 4)
+			{
+				__m128i c0 = _mm_add_epi32(_mm_set1_epi32((int)(_first + (uint32_t)i)), lane);
+				__m128i c1 = _mm_set1_epi32((int)_frame);
+				__m128i c2 = _mm_setzero_si128();
+				__m128i c3 = _mm_setzero_si128();
+				uint32_t k0 = m_key0, k1 = m_key1;
+				for (int round = 0; round < ROUNDS; ++round)
+				{
+					__m128i hi0, lo0, hi1, lo1;
+					mulhilo(c0, m0, hi0, lo0);
+					mulhilo(c2, m1, hi1, lo1);
+					c0 = _mm_xor_si128(_mm_xor_si128(hi1, c1), _mm_set1_epi32((int)k0));
+					c1 = lo1;
+					c2 = _mm_xor_si128(_mm_xor_si128(hi0, c3), _mm_set1_epi32((int)k1));
+					c3 = lo0;
+					k0 += W0;
+					k1 += W1;
+				}
+				_mm_storeu_ps(_out0 + i, _mm_mul_ps(_mm_cvtepi32_ps(_mm_srli_epi32(c0, 8)), scale));
+				_mm_storeu_ps(_out1 + i, _mm_mul_ps(_mm_cvtepi32_ps(_mm_srli_epi32(c1, 8)), scale));
+				_mm_storeu_ps(_out2 + i, _mm_mul_ps(_mm_cvtepi32_ps(_mm_srli_epi32(c2, 8)), scale));
+				_mm_storeu_ps(_out3 + i, _mm_mul_ps(_mm_cvtepi32_ps(_mm_srli_epi32(c3, 8)), scale));
+			}
+#endif
+			for (; i < _count; ++i)
+			{
+				float values[4];
+				uniform(_first + (uint32_t)i, _frame, values);
+				_out0[i] = values[0];
+				_out1[i] = values[1];
+				_out2[i] = values[2];
+				_out3[i] = values[3];
+			}
+		}
+
+		/** @brief Converts a random integer in a float
+		*	@param _bits A random value
+		*	@return A value in [0, 1), with 24 random bits
+		*/
+		static inline float toFloat(uint32_t _bits) { return (float)(_bits >> 8) * (1.0f / 16777216.0f); }
+
+	private:
+		static const int ROUNDS = 10;
+		static const uint32_t M0 = 0xD2511F53u;
+		static const uint32_t M1 = 0xCD9E8D57u;
+		static const uint32_t W0 = 0x9E3779B9u;
+		static const uint32_t W1 = 0xBB67AE85u;
+
+		uint32_t m_key0;
+		uint32_t m_key1;
+
+#ifdef SNOWGL_RANDOM_SSE2
+		// 32x32 -> 64 bit products of the 4 lanes, split in high and low halves
+		static inline void mulhilo(__m128i _a, __m128i _m, __m128i &_hi, __m128i &_lo)
+		{
+			__m128i even = _mm_mul_epu32(_a, _m);
+			__m128i odd = _mm_mul_epu32(_mm_srli_epi64(_a, 32), _m);
+			_lo = _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)), _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+			_hi = _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 3, 1)), _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 3, 1)));
+		}
+#endif
+	};
+}
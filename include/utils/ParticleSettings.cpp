@@ -0,0 +1,167 @@
+#include "ParticleSettings.h"
+
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+
+namespace SnowGL
+{
+	namespace
+	{
+		enum FieldType { FLOAT, VEC3, BOOL };
+
+		struct Field
+		{
+			const char	*name;
+			FieldType	type;
+			size_t		offset;
+		};
+
+		// the keys accepted in the settings file, and the member they set
+		const Field fields[] =
+		{
+			{ "particlesPerSecond",		FLOAT,	offsetof(ParticleSettings, particlesPerSecond) },
+			{ "lifetimeMin",			FLOAT,	offsetof(ParticleSettings, lifetimeMin) },
+			{ "lifetimeMax",			FLOAT,	offsetof(ParticleSettings, lifetimeMax) },
+			{ "collisionMultiplier",	FLOAT,	offsetof(ParticleSettings, collisionMultiplier) },
+			{ "globalWind",				VEC3,	offsetof(ParticleSettings, globalWind) },
+			{ "initialVelocity",		VEC3,	offsetof(ParticleSettings, initialVelocity) },
+			{ "acceleration",			VEC3,	offsetof(ParticleSettings, acceleration) },
+			{ "domainPosition",			VEC3,	offsetof(ParticleSettings, domainPosition) },
+			{ "domainSize",				VEC3,	offsetof(ParticleSettings, domainSize) },
+			{ "drawDomain",				BOOL,	offsetof(ParticleSettings, drawDomain) },
+			{ "drawPartition",			BOOL,	offsetof(ParticleSettings, drawPartition) },
+		};
+
+		inline bool isBlank(char _c) { return _c == ' ' || _c == '\t' || _c == '\r'; }
+
+		inline const char *skipBlanks(const char *_c, const char *_end)
+		{
+			while (_c < _end && isBlank(*_c))
+				++_c;
+			return _c;
+		}
+
+		// it parses a float, accepting blanks and commas as separators; false if no number is found (_value is not changed)
+		bool parseFloat(const char *&_c, const char *_end, float &_value)
+		{
+			while (_c < _end && (isBlank(*_c) || *_c == ','))
+				++_c;
+			char *next;
+			float value = strtof(_c, &next);
+			if (next == _c || next > _end)
+				return false;
+			_c = next;
+			_value = value;
+			return true;
+		}
+	}
+
+	void ParticleSettings::fromSettingsFile(const std::string &_filename)
+	{
+		// the whole file is read with a single call, and parsed in place
+		std::ifstream file(_filename.c_str(), std::ios::in | std::ios::binary);
+		if (!file)
+		{
+			std::cout << "ERROR::PARTICLESETTINGS:: unable to open " << _filename << std::endl;
+			return;
+		}
+		std::string text((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+		const char *c = text.c_str();
+		const char *end = c + text.size();
+		int lineNumber = 0;
+		while (c < end)
+		{
+			const char *lineEnd = (const char *)memchr(c, '\n', end - c);
+			if (!lineEnd)
+				lineEnd = end;
+			++lineNumber;
+
+			// comments (";" or "#") are removed
+			const char *valueEnd = c;
+			while (valueEnd < lineEnd && *valueEnd != ';' && *valueEnd != '#')
+				++valueEnd;
+
+			c = skipBlanks(c, valueEnd);
+			// empty lines and [sections] are skipped: all the keys belong to the particle settings
+			if (c == valueEnd || *c == '[')
+			{
+				c = lineEnd + 1;
+				continue;
+			}
+
+			const char *key = c;
+			while (c < valueEnd && *c != '=' && !isBlank(*c))
+				++c;
+			size_t keyLength = c - key;
+			c = skipBlanks(c, valueEnd);
+			if (c == valueEnd || *c != '=')
+			{
+				std::cout << "ERROR::PARTICLESETTINGS:: " << _filename << ":" << lineNumber << " missing '='" << std::endl;
+				c = lineEnd + 1;
+				continue;
+			}
+			++c;
+
+			const Field *field = nullptr;
+			for (size_t i = 0; i < sizeof(fields) / sizeof(fields[0]); ++i)
+			{
+				if (strlen(fields[i].name) == keyLength && strncmp(fields[i].name, key, keyLength) == 0)
+				{
+					field = &fields[i];
+					break;
+				}
+			}
+			if (!field)
+			{
+				std::cout << "WARNING::PARTICLESETTINGS:: " << _filename << ":" << lineNumber << " unknown key " << std::string(key, keyLength) << std::endl;
+				c = lineEnd + 1;
+				continue;
+			}
+
+			char *member = (char *)this + field->offset;
+			bool valid = true;
+			switch (field->type)
+			{
+			case FLOAT:
+			{
+				float value;
+				// nothing but blanks may follow the value
+				valid = parseFloat(c, valueEnd, value) && skipBlanks(c, valueEnd) == valueEnd;
+				if (valid)
+					*(float *)member = value;
+				break;
+			}
+			case VEC3:
+			{
+				glm::vec3 v;
+				valid = parseFloat(c, valueEnd, v.x) && parseFloat(c, valueEnd, v.y) && parseFloat(c, valueEnd, v.z)
+					&& skipBlanks(c, valueEnd) == valueEnd;
+				if (valid)
+					*(glm::vec3 *)member = v;
+				break;
+			}
+			case BOOL:
+			{
+				c = skipBlanks(c, valueEnd);
+				const char *word = c;
+				while (c < valueEnd && !isBlank(*c))
+					++c;
+				std::string value(word, c - word);
+				valid = (value == "true" || value == "false" || value == "1" || value == "0") && skipBlanks(c, valueEnd) == valueEnd;
+				if (valid)
+					*(bool *)member = value == "true" || value == "1";
+				break;
+			}
+			}
+			if (!valid)
+				std::cout << "ERROR::PARTICLESETTINGS:: " << _filename << ":" << lineNumber << " invalid value for " << field->name << std::endl;
+
+			c = lineEnd + 1;
+		}
+	}
+}
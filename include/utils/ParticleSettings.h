@@ -1,6 +1,8 @@
 #pragma once
 
 // cstdlib
+#include <climits>
+#include <cmath>
 
 // external libs
 
@@ -28,6 +30,7 @@ namespace SnowGL
 		glm::vec3	globalWind;								/**< Direction of the global wind modifier */
 
 		glm::vec3	initialVelocity = glm::vec3(0.0f);		/**< The initial velocity given to the particles when they spawn */
+		glm::vec3	acceleration = glm::vec3(0.0f, -0.4f, 0.0f);	/**< The constant acceleration applied to the particles */
 
 		glm::vec3	domainPosition = glm::vec3(0.0f);		/**< The position of the particle domain in 3D space */
 		glm::vec3	domainSize = glm::vec3(5.0f);			/**< The size of the particle domain */
@@ -38,9 +41,23 @@ namespace SnowGL
 		/** @brief Required particle count getter
 		*	@return The maxiumum number of particles that would be required for the system
 		*
-		*	Calculagtes the maxiumum number of particles that would be required for the system
+		*	Calculagtes the maxiumum number of particles that would be required for the system: the particles emitted during the
+		*	longest lifetime, 0 if the number is not representable
 		*/
-		inline int getMaxParticles() const { return (int)ceil(lifetimeMax) * (int)particlesPerSecond; }
+		inline int getMaxParticles() const
+		{
+			double count = std::ceil((double)lifetimeMax * particlesPerSecond);
+			// a NaN fails both tests
+			return count >= 0.0 && count <= (double)INT_MAX ? (int)count : 0;
+		}
+
+		/** @brief Checks the emission
+		*	@return false if the emission rate or the lifetime range cannot be used (no particles, or a NaN emission period)
+		*/
+		inline bool isValid() const
+		{
+			return particlesPerSecond > 0.0f && lifetimeMax > 0.0f && lifetimeMin >= 0.0f && lifetimeMin <= lifetimeMax && getMaxParticles() > 0;
+		}
 
 		/** @brief Loads the settings from a .ini file
 		*	@param _filename The settings file to load
@@ -0,0 +1,322 @@
+#pragma once
+
+// cstdlib
+#include <algorithm>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+// external libs
+#if defined(__AVX__)
+#include <immintrin.h>
+#elif defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define SNOWGL_PARTICLES_SSE
+#endif
+
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+
+// program
+
+namespace SnowGL
+{
+	/*! @class ParticleStore
+	*	@brief Structure-of-arrays storage for the CPU simulated particles
+	*
+	*	Every particle attribute lives in its own aligned float stream, so that the update kernel can
+	*	process 4 (SSE) or 8 (AVX) particles per instruction. The streams are padded to a multiple of
+	*	the widest vector, so a range which ends with the alive particles needs no scalar tail loop; the
+	*	ends of a range which do not fall on a multiple of LANES are updated with scalar loops.
+	*	The alive particles are always kept in [0, getAliveCount()): spawn() appends a particle, and
+	*	kill() moves the last alive particle in the freed slot, so the loops never visit dead slots.
+	*/
+	class ParticleStore
+	{
+	public:
+		static const size_t ALIGNMENT	= 32;	/**< Byte alignment of every stream (enough for AVX loads) */
+		static const size_t LANES		= 8;	/**< The capacity is rounded up to a multiple of this value */
+
+		float *xpos		= nullptr;	/**< Position on the x axis */
+		float *ypos		= nullptr;	/**< Position on the y axis */
+		float *yprev	= nullptr;	/**< Position on the y axis before the last update, for render interpolation */
+		float *zpos		= nullptr;	/**< Position on the z axis */
+		float *vel		= nullptr;	/**< Velocity, only goes down in y dir */
+		float *gravity	= nullptr;	/**< Acceleration added to vel at every update */
+		float *life		= nullptr;	/**< Remaining lifespan */
+		float *fade		= nullptr;	/**< Decay subtracted from life at every update */
+
+		/** @brief Allocates the streams
+		*	@param _capacity The number of particles the store has to hold
+		*
+		*	All the streams are zero initialised, padding included. It throws std::bad_alloc if a stream
+		*	cannot be allocated.
+		*/
+		explicit ParticleStore(size_t _capacity)
+			: m_size(_capacity), m_capacity((_capacity + LANES - 1) / LANES * LANES)
+		{
+			float **streams[] = { &xpos, &ypos, &yprev, &zpos, &vel, &gravity, &life, &fade };
+			for (size_t i = 0; i < NUM_STREAMS; ++i)
+			{
+				*streams[i] = allocateStream(m_capacity);
+				if (!*streams[i])
+				{
+					// the destructor does not run: the streams already allocated are freed here
+					for (size_t j = 0; j < i; ++j)
+						freeStream(*streams[j]);
+					throw std::bad_alloc();
+				}
+				memset(*streams[i], 0, m_capacity * sizeof(float));
+			}
+		}
+
+		~ParticleStore()
+		{
+			float *streams[] = { xpos, ypos, yprev, zpos, vel, gravity, life, fade };
+			for (size_t i = 0; i < NUM_STREAMS; ++i)
+				freeStream(streams[i]);
+		}
+
+		ParticleStore(const ParticleStore &) = delete;
+		ParticleStore &operator=(const ParticleStore &) = delete;
+
+		/** @brief Particle count getter
+		*	@return The maximum number of particles held by the store
+		*/
+		inline size_t getSize() const { return m_size; }
+
+		/** @brief Alive particle count getter
+		*	@return The number of alive particles, stored in [0, getAliveCount())
+		*/
+		inline size_t getAliveCount() const { return m_alive; }
+
+		/** @brief Takes a free slot for a new particle
+		*	@param _index Set to the slot of the new particle, which has to be initialised by the caller
+		*	@return false if the store is full
+		*/
+		inline bool spawn(size_t &_index)
+		{
+			if (m_alive == m_size)
+				return false;
+			_index = m_alive++;
+			return true;
+		}
+
+		/** @brief Takes free slots for a group of new particles
+		*	@param _count The number of particles to spawn
+		*	@param _first Set to the slot of the first new particle: the new particles are in [_first, _first + return value)
+		*	@return The number of spawned particles, less than _count if the store gets full
+		*/
+		inline size_t spawn(size_t _count, size_t &_first)
+		{
+			if (_count > m_size - m_alive)
+				_count = m_size - m_alive;
+			_first = m_alive;
+			m_alive += _count;
+			return _count;
+		}
+
+		/** @brief Removes a particle, moving the last alive particle in its slot
+		*	@param _index The slot of the particle to remove
+		*
+		*	When iterating over the particles, the slot _index has to be visited again after the call.
+		*/
+		void kill(size_t _index)
+		{
+			size_t last = --m_alive;
+			if (_index == last)
+				return;
+			float *streams[] = { xpos, ypos, yprev, zpos, vel, gravity, life, fade };
+			for (size_t i = 0; i < NUM_STREAMS; ++i)
+				streams[i][_index] = streams[i][last];
+		}
+
+		/** @brief Removes all the particles with a negative life
+		*	@return The number of removed particles
+		*/
+		size_t killExpired()
+		{
+			size_t killed = 0;
+			for (size_t i = 0; i < m_alive;)
+			{
+				if (life[i] < 0.0f)
+				{
+					kill(i);
+					++killed;
+				}
+				else
+					++i;
+			}
+			return killed;
+		}
+
+		/** @brief Removes all the particles */
+		inline void clear() { m_alive = 0; }
+
+		/** @brief Capacity getter
+		*	@return The number of slots allocated for every stream (a multiple of LANES)
+		*/
+		inline size_t getCapacity() const { return m_capacity; }
+
+		/** @brief Name of the compiled update kernel
+		*	@return "AVX", "SSE" or "scalar"
+		*/
+		static const char *getKernelName()
+		{
+#if defined(__AVX__)
+			return "AVX";
+#elif defined(SNOWGL_PARTICLES_SSE)
+			return "SSE";
+#else
+			return "scalar";
+#endif
+		}
+
+		/** @brief Advances every alive particle by one step
+		*	@param _velDivisor The velocity is divided by this value before being added to the position
+		*
+		*	yprev = ypos; ypos += vel / _velDivisor; vel += gravity; life -= fade
+		*/
+		inline void integrate(float _velDivisor) { integrate(0, m_alive, _velDivisor); }
+
+		/** @brief Advances the particles in [_begin, _end) by one step
+		*	@param _begin The first particle to update
+		*	@param _end One past the last particle to update
+		*	@param _velDivisor The velocity is divided by this value before being added to the position
+		*
+		*	Only the particles of the range are updated, so the ranges of different threads may share a vector:
+		*	the ends of the range which do not fall on a multiple of LANES are updated with scalar loops. A range
+		*	which reaches the last alive particle is widened to the padding, which is harmless.
+		*/
+		void integrate(size_t _begin, size_t _end, float _velDivisor)
+		{
+			size_t i, end;
+			vectorRange(_begin, _end, i, end);
+			integrateScalar(_begin, i, _velDivisor);
+			integrateScalar(end, _end, _velDivisor);
+#if defined(__AVX__)
+			const __m256 divisor = _mm256_set1_ps(_velDivisor);
+			for (; i < end; i += 8)
+			{
+				__m256 v = _mm256_load_ps(vel + i);
+				__m256 y = _mm256_load_ps(ypos + i);
+				_mm256_store_ps(yprev + i, y);
+				_mm256_store_ps(ypos + i, _mm256_add_ps(y, _mm256_div_ps(v, divisor)));
+				_mm256_store_ps(vel + i, _mm256_add_ps(v, _mm256_load_ps(gravity + i)));
+				_mm256_store_ps(life + i, _mm256_sub_ps(_mm256_load_ps(life + i), _mm256_load_ps(fade + i)));
+			}
+#elif defined(SNOWGL_PARTICLES_SSE)
+			const __m128 divisor = _mm_set1_ps(_velDivisor);
+			for (; i < end; i += 4)
+			{
+				__m128 v = _mm_load_ps(vel + i);
+				__m128 y = _mm_load_ps(ypos + i);
+				_mm_store_ps(yprev + i, y);
+				_mm_store_ps(ypos + i, _mm_add_ps(y, _mm_div_ps(v, divisor)));
+				_mm_store_ps(vel + i, _mm_add_ps(v, _mm_load_ps(gravity + i)));
+				_mm_store_ps(life + i, _mm_sub_ps(_mm_load_ps(life + i), _mm_load_ps(fade + i)));
+			}
+#else
+			integrateScalar(i, end, _velDivisor);
+#endif
+		}
+
+		/** @brief Reference implementation of integrate(), used when no SIMD instruction set is available
+		*/
+		void integrateScalar(size_t _begin, size_t _end, float _velDivisor)
+		{
+			for (size_t i = _begin; i < _end; ++i)
+			{
+				yprev[i] = ypos[i];
+				ypos[i] += vel[i] / _velDivisor;
+				vel[i] += gravity[i];
+				life[i] -= fade[i];
+			}
+		}
+
+		/** @brief Inverts the velocity of the particles in [_begin, _end) which are at or below a given height
+		*	@param _begin The first particle to test
+		*	@param _end One past the last particle to test
+		*	@param _floor The height at which particles bounce
+		*
+		*	The ends of the range are handled as in integrate().
+		*/
+		void reflectBelow(size_t _begin, size_t _end, float _floor)
+		{
+			size_t i, end;
+			vectorRange(_begin, _end, i, end);
+			reflectBelowScalar(_begin, i, _floor);
+			reflectBelowScalar(end, _end, _floor);
+#if defined(__AVX__)
+			const __m256 floor = _mm256_set1_ps(_floor);
+			const __m256 sign = _mm256_set1_ps(-0.0f);
+			for (; i < end; i += 8)
+			{
+				__m256 below = _mm256_cmp_ps(_mm256_load_ps(ypos + i), floor, _CMP_LE_OQ);
+				_mm256_store_ps(vel + i, _mm256_xor_ps(_mm256_load_ps(vel + i), _mm256_and_ps(below, sign)));
+			}
+#elif defined(SNOWGL_PARTICLES_SSE)
+			const __m128 floor = _mm_set1_ps(_floor);
+			const __m128 sign = _mm_set1_ps(-0.0f);
+			for (; i < end; i += 4)
+			{
+				__m128 below = _mm_cmple_ps(_mm_load_ps(ypos + i), floor);
+				_mm_store_ps(vel + i, _mm_xor_ps(_mm_load_ps(vel + i), _mm_and_ps(below, sign)));
+			}
+#else
+			reflectBelowScalar(i, end, _floor);
+#endif
+		}
+
+		/** @brief Reference implementation of reflectBelow(), used when no SIMD instruction set is available
+		*/
+		void reflectBelowScalar(size_t _begin, size_t _end, float _floor)
+		{
+			for (size_t i = _begin; i < _end; ++i)
+			{
+				if (ypos[i] <= _floor)
+					vel[i] = -vel[i];
+			}
+		}
+
+	private:
+		static const size_t NUM_STREAMS = 8;
+
+		size_t m_size;
+		size_t m_capacity;
+		size_t m_alive = 0;
+
+		// the whole vectors of a range: from the first multiple of LANES in it to the last one, or to the end of the
+		// padding if the range reaches the last alive particle. It is empty if the range has no whole vector
+		void vectorRange(size_t _begin, size_t _end, size_t &_first, size_t &_last) const
+		{
+			_first = (_begin + LANES - 1) / LANES * LANES;
+			_last = _end >= m_alive ? std::min((_end + LANES - 1) / LANES * LANES, m_capacity) : _end / LANES * LANES;
+			if (_first >= _last)
+				_first = _last = _end;
+		}
+
+		static float *allocateStream(size_t _count)
+		{
+#ifdef _WIN32
+			return (float *)_aligned_malloc(_count * sizeof(float), ALIGNMENT);
+#else
+			void *ptr = nullptr;
+			if (posix_memalign(&ptr, ALIGNMENT, _count * sizeof(float)) != 0)
+				return nullptr;
+			return (float *)ptr;
+#endif
+		}
+
+		static void freeStream(float *_stream)
+		{
+#ifdef _WIN32
+			_aligned_free(_stream);
+#else
+			free(_stream);
+#endif
+		}
+	};
+}
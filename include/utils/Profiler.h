@@ -0,0 +1,257 @@
+#pragma once
+
+// cstdlib
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// external libs
+
+// program
+
+// the zones are compiled out when SNOWGL_NO_PROFILER is defined (make release-minimal)
+#ifdef SNOWGL_NO_PROFILER
+#define SNOWGL_PROFILE_SCOPE(_name)
+#define SNOWGL_PROFILE_SCOPE_DETAIL(_name, _detail)
+#else
+#define SNOWGL_PROFILE_CONCAT_(_a, _b) _a##_b
+#define SNOWGL_PROFILE_CONCAT(_a, _b) SNOWGL_PROFILE_CONCAT_(_a, _b)
+/** @brief Records the time from this line to the end of the scope. The name must be a string literal */
+#define SNOWGL_PROFILE_SCOPE(_name) SnowGL::ProfileScope SNOWGL_PROFILE_CONCAT(profileScope, __COUNTER__)(_name)
+/** @brief The same, with a detail shown in the arguments of the zone (e.g., a file name), copied and truncated to 47 characters */
+#define SNOWGL_PROFILE_SCOPE_DETAIL(_name, _detail) SnowGL::ProfileScope SNOWGL_PROFILE_CONCAT(profileScope, __COUNTER__)(_name, _detail)
+#endif
+
+namespace SnowGL
+{
+	/*! @class Profiler
+	*	@brief Scoped CPU zones, recorded per thread and exported as Chrome trace events
+	*
+	*	Every thread records in its own buffer, a list of fixed-size blocks: the thread is the only writer,
+	*	and publishes each zone with an atomic counter, so recording takes no lock. A thread registers its
+	*	buffer (under a mutex) the first time it records a zone. Nothing is recorded until the profiler is
+	*	enabled. The buffers are kept until the end of the application, so the zones of the threads which
+	*	have ended can be exported too.
+	*	The trace file (JSON Trace Event Format) opens in chrome://tracing or in Perfetto.
+	*/
+	class Profiler
+	{
+	public:
+		/** @brief Enables or disables the recording
+		*	@param _enabled true to record the zones
+		*/
+		static void setEnabled(bool _enabled) { enabledFlag().store(_enabled, std::memory_order_relaxed); }
+
+		/** @brief Recording state getter
+		*	@return true if the zones are recorded
+		*/
+		static inline bool isEnabled() { return enabledFlag().load(std::memory_order_relaxed); }
+
+		/** @brief Time getter
+		*	@return The microseconds elapsed since the profiler was first used
+		*/
+		static inline double now()
+		{
+			static const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+		}
+
+		/** @brief Names the calling thread in the trace (the buffer is not registered until the thread records a zone)
+		*	@param _name The name of the thread
+		*/
+		static void setThreadName(const std::string &_name)
+		{
+			threadName() = _name;
+			std::lock_guard<std::mutex> lock(registry().mutex);
+			if (threadBufferPointer())
+				threadBufferPointer()->name = _name;
+		}
+
+		/** @brief Records a zone of the calling thread
+		*	@param _name The name of the zone (a string literal)
+		*	@param _detail An optional detail of the zone, or nullptr
+		*	@param _begin The start of the zone, from now()
+		*	@param _end The end of the zone, from now()
+		*/
+		static void record(const char *_name, const char *_detail, double _begin, double _end)
+		{
+			ThreadBuffer &buffer = threadBuffer();
+			Block *block = buffer.last;
+			unsigned count = block->count.load(std::memory_order_relaxed);
+			if (count == BLOCK_SIZE)
+			{
+				// the block is full: a new one is linked after it (the exporter reads next only after count)
+				Block *next = new Block();
+				block->next.store(next, std::memory_order_release);
+				buffer.last = block = next;
+				count = 0;
+			}
+			Zone &zone = block->zones[count];
+			zone.name = _name;
+			zone.begin = _begin;
+			zone.end = _end;
+			zone.detail[0] = '\0';
+			if (_detail)
+				strncat(zone.detail, _detail, DETAIL_SIZE - 1);
+			block->count.store(count + 1, std::memory_order_release);
+		}
+
+		/** @brief Writes the zones recorded so far as a Chrome trace
+		*	@param _filename The JSON file to write
+		*	@return false if the file cannot be written
+		*/
+		static bool writeChromeTrace(const std::string &_filename)
+		{
+			FILE *file = fopen(_filename.c_str(), "w");
+			if (!file)
+				return false;
+
+			Registry &reg = registry();
+			std::lock_guard<std::mutex> lock(reg.mutex);
+			fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+			bool first = true;
+			for (size_t tid = 0; tid < reg.buffers.size(); ++tid)
+			{
+				const ThreadBuffer &buffer = *reg.buffers[tid];
+				fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"%s\"}}",
+					first ? "" : ",\n", (unsigned)tid, escape(buffer.name).c_str());
+				first = false;
+				for (const Block *block = &buffer.first; block; block = block->next.load(std::memory_order_acquire))
+				{
+					unsigned count = block->count.load(std::memory_order_acquire);
+					for (unsigned i = 0; i < count; ++i)
+					{
+						const Zone &zone = block->zones[i];
+						fprintf(file, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f",
+							escape(zone.name).c_str(), (unsigned)tid, zone.begin, zone.end - zone.begin);
+						if (zone.detail[0])
+							fprintf(file, ",\"args\":{\"detail\":\"%s\"}", escape(zone.detail).c_str());
+						fprintf(file, "}");
+					}
+				}
+			}
+			fprintf(file, "\n]}\n");
+			return fclose(file) == 0;
+		}
+
+	private:
+		static const unsigned BLOCK_SIZE = 1024;
+		static const unsigned DETAIL_SIZE = 48;
+
+		struct Zone
+		{
+			const char	*name;
+			double		begin;
+			double		end;
+			char		detail[DETAIL_SIZE];
+		};
+
+		struct Block
+		{
+			Zone					zones[BLOCK_SIZE];
+			std::atomic<unsigned>	count{ 0 };
+			std::atomic<Block *>	next{ nullptr };
+
+			Block() = default;
+			~Block() { delete next.load(); }
+		};
+
+		struct ThreadBuffer
+		{
+			Block		first;
+			Block		*last = &first;
+			std::string	name;
+		};
+
+		struct Registry
+		{
+			std::mutex									mutex;
+			std::vector<std::unique_ptr<ThreadBuffer>>	buffers;
+		};
+
+		static std::atomic<bool> &enabledFlag()
+		{
+			static std::atomic<bool> enabled(false);
+			return enabled;
+		}
+
+		static Registry &registry()
+		{
+			static Registry reg;
+			return reg;
+		}
+
+		static std::string &threadName()
+		{
+			static thread_local std::string name;
+			return name;
+		}
+
+		static ThreadBuffer *&threadBufferPointer()
+		{
+			static thread_local ThreadBuffer *buffer = nullptr;
+			return buffer;
+		}
+
+		// the buffer of the calling thread, registered on the first call
+		static ThreadBuffer &threadBuffer()
+		{
+			ThreadBuffer *&buffer = threadBufferPointer();
+			if (!buffer)
+			{
+				Registry &reg = registry();
+				std::lock_guard<std::mutex> lock(reg.mutex);
+				reg.buffers.emplace_back(new ThreadBuffer());
+				buffer = reg.buffers.back().get();
+				buffer->name = threadName().empty() ? "thread " + std::to_string(reg.buffers.size() - 1) : threadName();
+			}
+			return *buffer;
+		}
+
+		static std::string escape(const std::string &_text)
+		{
+			std::string escaped;
+			for (char c : _text)
+			{
+				if (c == '"' || c == '\\')
+					escaped += '\\';
+				if ((unsigned char)c >= 0x20)
+					escaped += c;
+			}
+			return escaped;
+		}
+	};
+
+	/*! @class ProfileScope
+	*	@brief A zone of the profiler, from the constructor to the destructor (see SNOWGL_PROFILE_SCOPE)
+	*/
+	class ProfileScope
+	{
+	public:
+		/** @brief Constructor: it starts the zone
+		*	@param _name The name of the zone (a string literal)
+		*	@param _detail An optional detail of the zone
+		*/
+		explicit ProfileScope(const char *_name, const char *_detail = nullptr)
+			: m_name(_name), m_detail(_detail), m_begin(Profiler::isEnabled() ? Profiler::now() : -1.0) {}
+
+		~ProfileScope()
+		{
+			if (m_begin >= 0.0)
+				Profiler::record(m_name, m_detail, m_begin, Profiler::now());
+		}
+
+		ProfileScope(const ProfileScope &) = delete;
+		ProfileScope &operator=(const ProfileScope &) = delete;
+
+	private:
+		const char	*m_name;
+		const char	*m_detail;
+		double		m_begin;
+	};
+}
@@ -0,0 +1,207 @@
+#pragma once
+
+// cstdlib
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+// external libs
+#include <glad/glad.h>
+
+// program
+
+namespace SnowGL
+{
+	/*! @class RenderList
+	*	@brief The draws of a pass, sorted by a 64-bit key to minimize the state changes
+	*
+	*	An item is a mesh (its VAO and index count) drawn with a program and a material, and the index of its transforms
+	*	in the TransformRing; an instanced item draws the mesh for consecutive transforms with a single draw call. The sort key packs, from the most significant bits, the program (8 bits), the material
+	*	(12 bits), the VAO (20 bits) and the position of the item in the list (24 bits, so the order is stable and the
+	*	key is enough to find the item). submit() draws the items in key order, and changes the program, the texture and
+	*	the VAO only when they differ from those of the previous draw.
+	*	Programs and materials are registered once; the items are added again each frame.
+	*	glUseProgram resets the subroutine uniforms of the program, even when it is already in use: the fragment
+	*	subroutines of a program are set with setFragmentSubroutines(), and submit() sets them again after binding it.
+	*/
+	class RenderList
+	{
+	public:
+		/*! @struct Stats
+		*	@brief The draws and the state changes of the last submit()
+		*/
+		struct Stats
+		{
+			unsigned int draws = 0;				/**< The draw calls */
+			unsigned int programChanges = 0;	/**< The glUseProgram calls */
+			unsigned int materialChanges = 0;	/**< The texture binds (with the uniforms of the material) */
+			unsigned int vaoChanges = 0;		/**< The glBindVertexArray calls */
+			unsigned int instances = 0;			/**< The objects drawn (more than the draws with instancing) */
+		};
+
+		static const unsigned MAX_PROGRAMS = 1 << 8;		/**< The maximum number of programs */
+		static const unsigned MAX_MATERIALS = 1 << 12;	/**< The maximum number of materials */
+		static const unsigned MAX_ITEMS = 1 << 24;		/**< The maximum number of items in a list */
+		static const GLuint TEXTURE_UNIT = 0;			/**< The texture unit of the material textures */
+
+		/** @brief Registers a program, with the locations of the uniforms written by submit()
+		*	@param _program The program
+		*	@param _objectIndex The location of the index of the object transforms
+		*	@param _texture The location of the sampler of the material texture
+		*	@param _repeat The location of the UV repetitions of the material (-1 if the program has none)
+		*	@return The id of the program in the list
+		*/
+		int addProgram(GLuint _program, GLint _objectIndex, GLint _texture, GLint _repeat)
+		{
+			Program program = { _program, _objectIndex, _texture, _repeat };
+			m_programs.push_back(program);
+			return (int)m_programs.size() - 1;
+		}
+
+		/** @brief Sets the fragment subroutines of a program, applied by submit() each time the program is bound
+		*	@param _program The id of the program
+		*	@param _indices The subroutine index of each subroutine uniform location of the fragment shader
+		*	@param _count The number of subroutine uniform locations (0 if the program has none)
+		*/
+		void setFragmentSubroutines(int _program, const GLuint *_indices, GLsizei _count)
+		{
+			m_programs[_program].fragmentSubroutines.assign(_indices, _indices + _count);
+		}
+
+		/** @brief Registers a material
+		*	@param _texture The 2D texture, bound on unit TEXTURE_UNIT
+		*	@param _repeat The UV repetitions
+		*	@return The id of the material in the list
+		*/
+		int addMaterial(GLuint _texture, GLfloat _repeat)
+		{
+			Material material = { _texture, _repeat };
+			m_materials.push_back(material);
+			return (int)m_materials.size() - 1;
+		}
+
+		/** @brief Removes the items, keeping programs and materials
+		*/
+		inline void clear()
+		{
+			m_items.clear();
+			m_keys.clear();
+		}
+
+		/** @brief Adds a draw
+		*	@param _program The id of the program
+		*	@param _material The id of the material, or -1 for a draw without material (depth only)
+		*	@param _vao The vertex array of the mesh, with an element buffer of unsigned ints
+		*	@param _indexCount The number of indices
+		*	@param _object The index of the transforms of the object in the TransformRing (of the first instance)
+		*	@param _instanceCount The number of instances, with consecutive transforms
+		*/
+		void add(int _program, int _material, GLuint _vao, GLsizei _indexCount, GLint _object, GLsizei _instanceCount = 1)
+		{
+			if (m_items.size() >= MAX_ITEMS)
+				return;
+			Item item = { _program, _material, _vao, _indexCount, _object, _instanceCount };
+			uint64_t key = ((uint64_t)(_program & (MAX_PROGRAMS - 1)) << 56)
+				| ((uint64_t)(_material & (MAX_MATERIALS - 1)) << 44)
+				| ((uint64_t)(_vao & 0xFFFFF) << 24)
+				| (uint64_t)m_items.size();
+			m_items.push_back(item);
+			m_keys.push_back(key);
+		}
+
+		/** @brief Sorts the items by key
+		*/
+		inline void sort() { std::sort(m_keys.begin(), m_keys.end()); }
+
+		/** @brief Draws the items in key order. The transforms of the objects must be bound
+		*	@return The draws and the state changes
+		*/
+		const Stats &submit()
+		{
+			m_stats = Stats();
+			int program = -1, material = -1;
+			GLuint vao = 0;
+			for (uint64_t key : m_keys)
+			{
+				const Item &item = m_items[key & (MAX_ITEMS - 1)];
+				const Program &itemProgram = m_programs[item.program];
+				if (item.program != program)
+				{
+					glUseProgram(itemProgram.program);
+					if (!itemProgram.fragmentSubroutines.empty())
+						glUniformSubroutinesuiv(GL_FRAGMENT_SHADER, (GLsizei)itemProgram.fragmentSubroutines.size(), itemProgram.fragmentSubroutines.data());
+					glUniform1i(itemProgram.texture, TEXTURE_UNIT);
+					program = item.program;
+					// the uniforms of the material are those of the program
+					material = -1;
+					++m_stats.programChanges;
+				}
+				if (item.material != material && item.material >= 0)
+				{
+					glActiveTexture(GL_TEXTURE0 + TEXTURE_UNIT);
+					glBindTexture(GL_TEXTURE_2D, m_materials[item.material].texture);
+					glUniform1f(itemProgram.repeat, m_materials[item.material].repeat);
+					material = item.material;
+					++m_stats.materialChanges;
+				}
+				if (item.vao != vao)
+				{
+					glBindVertexArray(item.vao);
+					vao = item.vao;
+					++m_stats.vaoChanges;
+				}
+				glUniform1i(itemProgram.objectIndex, item.object);
+				if (item.instanceCount == 1)
+					glDrawElements(GL_TRIANGLES, item.indexCount, GL_UNSIGNED_INT, 0);
+				else
+					glDrawElementsInstanced(GL_TRIANGLES, item.indexCount, GL_UNSIGNED_INT, 0, item.instanceCount);
+				++m_stats.draws;
+				m_stats.instances += item.instanceCount;
+			}
+			glBindVertexArray(0);
+			return m_stats;
+		}
+
+		/** @brief Item count getter
+		*	@return The number of items in the list
+		*/
+		inline size_t size() const { return m_items.size(); }
+
+		/** @brief Stats getter
+		*	@return The draws and the state changes of the last submit()
+		*/
+		inline const Stats &getStats() const { return m_stats; }
+
+	private:
+		struct Program
+		{
+			GLuint				program;
+			GLint				objectIndex;
+			GLint				texture;
+			GLint				repeat;
+			std::vector<GLuint>	fragmentSubroutines;
+		};
+
+		struct Material
+		{
+			GLuint	texture;
+			GLfloat	repeat;
+		};
+
+		struct Item
+		{
+			int		program;
+			int		material;
+			GLuint	vao;
+			GLsizei	indexCount;
+			GLint	object;
+			GLsizei	instanceCount;
+		};
+
+		std::vector<Program>	m_programs;
+		std::vector<Material>	m_materials;
+		std::vector<Item>		m_items;
+		std::vector<uint64_t>	m_keys;
+		Stats					m_stats;
+	};
+}
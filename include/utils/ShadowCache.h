@@ -0,0 +1,179 @@
+#pragma once
+
+// cstdlib
+#include <vector>
+
+// external libs
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+// program
+
+namespace SnowGL
+{
+	/*! @class ShadowCache
+	*	@brief Shadow maps whose static casters are rendered only when the light or the static geometry change
+	*
+	*	The maps are the layers of a depth texture array (a layer for each cascade). The depth of the static casters of
+	*	each layer is kept in the same layer of a cache array. When a layer is updated, the cache layer is copied in
+	*	it (a depth blit), and only the dynamic casters are rendered on top of it. The cache layer is rendered again
+	*	when the light matrix of the layer changes, or after invalidate(): with a still light, the shadow pass costs the
+	*	copy and the draws of the moving objects.
+	*	Both arrays have the same format (a depth blit needs it); outside the map, the border is at the far plane, so the
+	*	areas not covered by the light are lit. The maps compare the depth of a lookup with the stored one
+	*	(GL_COMPARE_REF_TO_TEXTURE, for a sampler2DArrayShadow) and filter the results of the 4 nearest texels; the
+	*	cache is only copied, and it is not filtered.
+	*/
+	class ShadowCache
+	{
+	public:
+		ShadowCache() = default;
+		~ShadowCache() { destroy(); }
+
+		ShadowCache(const ShadowCache &) = delete;
+		ShadowCache &operator=(const ShadowCache &) = delete;
+
+		/** @brief Creates the textures and the framebuffers
+		*	@param _width The width of the shadow maps
+		*	@param _height The height of the shadow maps
+		*	@param _layers The number of shadow maps
+		*/
+		void create(GLsizei _width, GLsizei _height, GLsizei _layers = 1)
+		{
+			destroy();
+			m_width = _width;
+			m_height = _height;
+			m_layers.assign(_layers, Layer());
+			for (int i = 0; i < 2; ++i)
+			{
+				glGenTextures(1, &m_textures[i]);
+				glBindTexture(GL_TEXTURE_2D_ARRAY, m_textures[i]);
+				glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_DEPTH_COMPONENT, _width, _height, _layers, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
+				GLint filter = i == MAP ? GL_LINEAR : GL_NEAREST;
+				glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, filter);
+				glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, filter);
+				if (i == MAP)
+				{
+					glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+					glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+				}
+				glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
+				glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
+				GLfloat borderColor[] = { 1.0f, 1.0f, 1.0f, 1.0f };
+				glTexParameterfv(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_BORDER_COLOR, borderColor);
+
+				// a framebuffer for each layer, depth only: no color is written nor read
+				for (GLsizei layer = 0; layer < _layers; ++layer)
+				{
+					GLuint &framebuffer = m_layers[layer].framebuffers[i];
+					glGenFramebuffers(1, &framebuffer);
+					glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+					glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, m_textures[i], 0, layer);
+					glDrawBuffer(GL_NONE);
+					glReadBuffer(GL_NONE);
+				}
+			}
+			glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+			glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		}
+
+		/** @brief Deletes the textures and the framebuffers
+		*/
+		void destroy()
+		{
+			if (m_textures[0] == 0)
+				return;
+			for (Layer &layer : m_layers)
+				glDeleteFramebuffers(2, layer.framebuffers);
+			glDeleteTextures(2, m_textures);
+			m_textures[0] = m_textures[1] = 0;
+			m_layers.clear();
+		}
+
+		/** @brief Forces the rendering of the static casters of all the layers at their next update (when the static
+		*	geometry changes)
+		*/
+		inline void invalidate()
+		{
+			for (Layer &layer : m_layers)
+				layer.valid = false;
+		}
+
+		/** @brief Checks the cache of a layer against the light matrix of its update
+		*	@param _layer The layer
+		*	@param _lightSpaceMatrix The projection matrix multiplied by the view matrix of the light
+		*	@return true if the static casters must be rendered, between beginStatic() and endStatic()
+		*/
+		bool needsStaticUpdate(GLsizei _layer, const glm::mat4 &_lightSpaceMatrix)
+		{
+			Layer &layer = m_layers[_layer];
+			if (layer.valid && _lightSpaceMatrix == layer.lightSpaceMatrix)
+				return false;
+			layer.lightSpaceMatrix = _lightSpaceMatrix;
+			return true;
+		}
+
+		/** @brief Binds and clears the cache of a layer, for the rendering of the static casters
+		*	@param _layer The layer
+		*/
+		void beginStatic(GLsizei _layer)
+		{
+			glBindFramebuffer(GL_FRAMEBUFFER, m_layers[_layer].framebuffers[CACHE]);
+			glViewport(0, 0, m_width, m_height);
+			glClear(GL_DEPTH_BUFFER_BIT);
+		}
+
+		/** @brief Marks the cache of a layer as valid
+		*	@param _layer The layer
+		*/
+		inline void endStatic(GLsizei _layer)
+		{
+			m_layers[_layer].valid = true;
+			++m_staticUpdates;
+		}
+
+		/** @brief Copies the cache of a layer in the shadow map, and binds it for the rendering of the dynamic casters
+		*	@param _layer The layer
+		*/
+		void beginDynamic(GLsizei _layer)
+		{
+			const Layer &layer = m_layers[_layer];
+			glBindFramebuffer(GL_READ_FRAMEBUFFER, layer.framebuffers[CACHE]);
+			glBindFramebuffer(GL_DRAW_FRAMEBUFFER, layer.framebuffers[MAP]);
+			glBlitFramebuffer(0, 0, m_width, m_height, 0, 0, m_width, m_height, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+			glBindFramebuffer(GL_FRAMEBUFFER, layer.framebuffers[MAP]);
+			glViewport(0, 0, m_width, m_height);
+		}
+
+		/** @brief Shadow maps getter
+		*	@return The depth texture array with the static and the dynamic casters, to sample in the lighting pass
+		*/
+		inline GLuint getDepthMap() const { return m_textures[MAP]; }
+
+		/** @brief Layer count getter
+		*	@return The number of shadow maps
+		*/
+		inline GLsizei getLayerCount() const { return (GLsizei)m_layers.size(); }
+
+		/** @brief Static updates getter
+		*	@return The number of times the static casters of a layer have been rendered
+		*/
+		inline unsigned long long getStaticUpdates() const { return m_staticUpdates; }
+
+	private:
+		enum { CACHE, MAP };
+
+		struct Layer
+		{
+			GLuint		framebuffers[2] = {};
+			glm::mat4	lightSpaceMatrix;
+			bool		valid = false;
+		};
+
+		GLuint				m_textures[2] = {};
+		std::vector<Layer>	m_layers;
+		GLsizei				m_width = 0;
+		GLsizei				m_height = 0;
+		unsigned long long	m_staticUpdates = 0;
+	};
+}
@@ -0,0 +1,206 @@
+#pragma once
+
+// cstdlib
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+// external libs
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+// program
+#include <utils/Bounds.h>
+
+namespace SnowGL
+{
+	/*! @class ShadowCascades
+	*	@brief The light matrices of cascaded shadow maps, fitted to slices of the camera frustum, and their update schedule
+	*
+	*	The camera frustum, up to the shadow distance, is split in slices with the practical split scheme (a blend of
+	*	the logarithmic and the uniform splits). A cascade is an orthographic projection of the light containing the
+	*	bounding sphere of its slice: the size does not change when the camera turns, and the center is snapped to the
+	*	texels of the map, so the shadows do not shimmer and the matrix stays the same while the camera is still (the
+	*	static casters can be cached). The depth range contains all the casters of the scene.
+	*	The first cascade is updated at every frame; the others in turn, each once every updatePeriod frames, so at
+	*	most one far cascade is rendered in a frame (when the period is not less than their number). A cascade is
+	*	sampled with the matrix of its last update (getMatrices()), and with the texel size and the depth range of that
+	*	matrix, to measure the depth bias in texels of the cascade.
+	*/
+	class ShadowCascades
+	{
+	public:
+		static const int MAX_CASCADES = 4;	/**< The maximum number of cascades (MAX_CASCADES in the shaders) */
+
+		/** @brief Sets the cascades
+		*	@param _count The number of cascades (1 to MAX_CASCADES)
+		*	@param _updatePeriod The frames between two updates of a far cascade
+		*	@param _resolution The size of the shadow maps, in texels
+		*	@param _shadowDistance The distance from the camera covered by the cascades
+		*	@param _splitLambda The weight of the logarithmic splits (0: uniform, 1: logarithmic)
+		*/
+		void configure(int _count, int _updatePeriod, int _resolution, float _shadowDistance, float _splitLambda = 0.75f)
+		{
+			m_count = std::max(1, std::min(_count, (int)MAX_CASCADES));
+			m_updatePeriod = std::max(1, _updatePeriod);
+			m_resolution = (float)_resolution;
+			m_shadowDistance = _shadowDistance;
+			m_splitLambda = _splitLambda;
+			for (int i = 0; i < MAX_CASCADES; ++i)
+				m_rendered[i] = false;
+		}
+
+		/** @brief Fits the cascades to the camera of the frame
+		*	@param _projection The perspective projection matrix of the camera
+		*	@param _view The view matrix of the camera
+		*	@param _lightDirection The direction towards the light
+		*	@param _casterBounds The box containing all the shadow casters
+		*/
+		void fit(const glm::mat4 &_projection, const glm::mat4 &_view, const glm::vec3 &_lightDirection, const AABB &_casterBounds)
+		{
+			// near and far planes of the camera, from the projection matrix
+			float nearPlane = _projection[3][2] / (_projection[2][2] - 1.0f);
+			float farPlane = _projection[3][2] / (_projection[2][2] + 1.0f);
+			float distance = std::min(m_shadowDistance, farPlane);
+
+			// the corners of the near and the far planes, in world coordinates
+			glm::mat4 inverse = glm::inverse(_projection * _view);
+			glm::vec3 nearCorners[4], farCorners[4];
+			for (int i = 0; i < 4; ++i)
+			{
+				glm::vec4 ndc((i & 1) ? 1.0f : -1.0f, (i & 2) ? 1.0f : -1.0f, -1.0f, 1.0f);
+				glm::vec4 nearCorner = inverse * ndc;
+				ndc.z = 1.0f;
+				glm::vec4 farCorner = inverse * ndc;
+				nearCorners[i] = glm::vec3(nearCorner) / nearCorner.w;
+				farCorners[i] = glm::vec3(farCorner) / farCorner.w;
+			}
+
+			// the light looks along its direction; the depth range contains the casters
+			glm::vec3 up = std::abs(_lightDirection.y) > 0.99f * glm::length(_lightDirection) ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+			glm::mat4 lightView = glm::lookAt(glm::vec3(0.0f), -_lightDirection, up);
+			float minZ = FLT_MAX, maxZ = -FLT_MAX;
+			for (int i = 0; i < 8; ++i)
+			{
+				glm::vec3 corner((i & 1) ? _casterBounds.max.x : _casterBounds.min.x, (i & 2) ? _casterBounds.max.y : _casterBounds.min.y,
+					(i & 4) ? _casterBounds.max.z : _casterBounds.min.z);
+				float z = (lightView * glm::vec4(corner, 1.0f)).z;
+				minZ = std::min(minZ, z);
+				maxZ = std::max(maxZ, z);
+			}
+
+			float sliceNear = nearPlane;
+			for (int c = 0; c < m_count; ++c)
+			{
+				// practical split scheme
+				float ratio = (float)(c + 1) / m_count;
+				float logSplit = nearPlane * std::pow(distance / nearPlane, ratio);
+				float uniformSplit = nearPlane + (distance - nearPlane) * ratio;
+				float sliceFar = m_splitLambda * logSplit + (1.0f - m_splitLambda) * uniformSplit;
+				m_splits[c] = sliceFar;
+
+				// the corners of the slice are on the edges of the frustum, which are linear in the view depth
+				glm::vec3 corners[8];
+				glm::vec3 center(0.0f);
+				for (int i = 0; i < 4; ++i)
+				{
+					corners[i] = glm::mix(nearCorners[i], farCorners[i], (sliceNear - nearPlane) / (farPlane - nearPlane));
+					corners[i + 4] = glm::mix(nearCorners[i], farCorners[i], (sliceFar - nearPlane) / (farPlane - nearPlane));
+					center += corners[i] + corners[i + 4];
+				}
+				center /= 8.0f;
+				float radius = 0.0f;
+				for (int i = 0; i < 8; ++i)
+					radius = std::max(radius, glm::length(corners[i] - center));
+				// rounded up, so it does not change with the rounding errors
+				radius = std::ceil(radius * 16.0f) / 16.0f;
+
+				// the center is snapped to the texels of the map
+				float texel = 2.0f * radius / m_resolution;
+				glm::vec3 lightCenter = glm::vec3(lightView * glm::vec4(center, 1.0f));
+				lightCenter.x = std::floor(lightCenter.x / texel) * texel;
+				lightCenter.y = std::floor(lightCenter.y / texel) * texel;
+				glm::mat4 lightProjection = glm::ortho(lightCenter.x - radius, lightCenter.x + radius, lightCenter.y - radius, lightCenter.y + radius,
+					-maxZ, -minZ);
+				m_fitted[c] = lightProjection * lightView;
+				m_fittedTexelSizes[c] = texel;
+				m_fittedDepthRanges[c] = maxZ - minZ;
+				sliceNear = sliceFar;
+			}
+		}
+
+		/** @brief Update schedule
+		*	@param _cascade The cascade
+		*	@param _frame The number of the frame
+		*	@return true if the cascade must be rendered in the frame
+		*/
+		inline bool isDue(int _cascade, unsigned long long _frame) const
+		{
+			if (_cascade == 0 || !m_rendered[_cascade])
+				return true;
+			return _frame % m_updatePeriod == (unsigned long long)((_cascade - 1) % m_updatePeriod);
+		}
+
+		/** @brief Marks a cascade as rendered with its fitted matrix
+		*	@param _cascade The cascade
+		*/
+		inline void markRendered(int _cascade)
+		{
+			m_matrices[_cascade] = m_fitted[_cascade];
+			m_texelSizes[_cascade] = m_fittedTexelSizes[_cascade];
+			m_depthRanges[_cascade] = m_fittedDepthRanges[_cascade];
+			m_rendered[_cascade] = true;
+		}
+
+		/** @brief Fitted matrix getter
+		*	@param _cascade The cascade
+		*	@return The light matrix fitted to the camera of the frame, to render the cascade
+		*/
+		inline const glm::mat4 &getFitted(int _cascade) const { return m_fitted[_cascade]; }
+
+		/** @brief Matrices getter
+		*	@return The light matrices of the cascades at their last update, to sample the shadow maps
+		*/
+		inline const glm::mat4 *getMatrices() const { return m_matrices; }
+
+		/** @brief Texel sizes getter
+		*	@return The size of a texel of the shadow map of each cascade at its last update, in world units
+		*/
+		inline const float *getTexelSizes() const { return m_texelSizes; }
+
+		/** @brief Depth ranges getter
+		*	@return The distance along the light between the depths 0 and 1 of each cascade at its last update, in world units
+		*/
+		inline const float *getDepthRanges() const { return m_depthRanges; }
+
+		/** @brief Splits getter
+		*	@return The far distance from the camera of each cascade
+		*/
+		inline const float *getSplits() const { return m_splits; }
+
+		/** @brief Count getter
+		*	@return The number of cascades
+		*/
+		inline int getCount() const { return m_count; }
+
+		/** @brief Update period getter
+		*	@return The frames between two updates of a far cascade
+		*/
+		inline int getUpdatePeriod() const { return m_updatePeriod; }
+
+	private:
+		int			m_count = 1;
+		int			m_updatePeriod = 1;
+		float		m_resolution = 1024.0f;
+		float		m_shadowDistance = 100.0f;
+		float		m_splitLambda = 0.75f;
+		glm::mat4	m_fitted[MAX_CASCADES];
+		glm::mat4	m_matrices[MAX_CASCADES];
+		float		m_fittedTexelSizes[MAX_CASCADES] = {};
+		float		m_texelSizes[MAX_CASCADES] = {};
+		float		m_fittedDepthRanges[MAX_CASCADES] = {};
+		float		m_depthRanges[MAX_CASCADES] = {};
+		float		m_splits[MAX_CASCADES] = {};
+		bool		m_rendered[MAX_CASCADES] = {};
+	};
+}
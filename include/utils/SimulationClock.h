@@ -0,0 +1,99 @@
+#pragma once
+
+// cstdlib
+
+// external libs
+
+// program
+
+namespace SnowGL
+{
+	/*! @class SimulationClock
+	*	@brief Accumulator based fixed timestep clock for the particle simulation
+	*
+	*	The frame time is accumulated, and consumed in steps of constant length: the simulation
+	*	behaves in the same way at any frame rate. What is left in the accumulator (less than one
+	*	step) is returned as an interpolation factor for rendering.
+	*	The number of steps per frame is capped: after a long hitch the excess time is dropped
+	*	instead of being simulated, so a slow frame cannot make the following ones even slower.
+	*/
+	class SimulationClock
+	{
+	public:
+		/** @brief Constructor
+		*	@param _fixedStep The length of a simulation step, in seconds
+		*	@param _maxSteps The maximum number of steps simulated in a single frame
+		*/
+		SimulationClock(float _fixedStep = 1.0f / 60.0f, int _maxSteps = 5)
+			: m_fixedStep(_fixedStep), m_maxSteps(_maxSteps) {}
+
+		/** @brief Adds the duration of the last frame to the accumulator
+		*	@param _frameTime The time elapsed since the previous call, in seconds
+		*	@return The number of fixed steps to simulate for this frame (at most the maximum catch-up count)
+		*/
+		int advance(float _frameTime)
+		{
+			if (_frameTime > 0.0f)
+				m_accumulator += _frameTime;
+
+			int steps = (int)(m_accumulator / m_fixedStep);
+			if (steps > m_maxSteps)
+			{
+				// we are too late to catch up: we simulate what we can and drop the rest
+				m_droppedTime += m_accumulator - m_maxSteps * (double)m_fixedStep;
+				m_accumulator = m_maxSteps * (double)m_fixedStep;
+				steps = m_maxSteps;
+			}
+			m_accumulator -= steps * (double)m_fixedStep;
+			m_stepCount += steps;
+			return steps;
+		}
+
+		/** @brief Interpolation factor getter
+		*	@return How far the rendered frame is between the last simulated step and the next one, in [0, 1)
+		*/
+		inline float getAlpha() const { return (float)(m_accumulator / m_fixedStep); }
+
+		/** @brief Simulated time getter
+		*	@return The time reached by the simulation after all the steps returned so far, in seconds
+		*/
+		inline double getTime() const { return m_stepCount * (double)m_fixedStep; }
+
+		/** @brief Step count getter
+		*	@return The number of steps returned so far
+		*/
+		inline unsigned long long getStepCount() const { return m_stepCount; }
+
+		/** @brief Step length getter
+		*	@return The length of a simulation step, in seconds
+		*/
+		inline float getFixedStep() const { return m_fixedStep; }
+
+		/** @brief Maximum catch-up getter
+		*	@return The maximum number of steps simulated in a single frame
+		*/
+		inline int getMaxSteps() const { return m_maxSteps; }
+
+		/** @brief Dropped time getter
+		*	@return The total time that was not simulated because a frame needed too many steps, in seconds
+		*/
+		inline double getDroppedTime() const { return m_droppedTime; }
+
+		/** @brief Sets the length of a simulation step
+		*	@param _fixedStep The length of a simulation step, in seconds
+		*/
+		inline void setFixedStep(float _fixedStep) { m_fixedStep = _fixedStep; }
+
+		/** @brief Sets the maximum catch-up
+		*	@param _maxSteps The maximum number of steps simulated in a single frame
+		*/
+		inline void setMaxSteps(int _maxSteps) { m_maxSteps = _maxSteps; }
+
+	private:
+		float				m_fixedStep;
+		int					m_maxSteps;
+		double				m_accumulator = 0.0;
+		double				m_droppedTime = 0.0;
+		unsigned long long	m_stepCount = 0;
+	};
+}
@@ -0,0 +1,236 @@
+#pragma once
+
+// cstdlib
+#include <algorithm>
+
+// external libs
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_inverse.hpp>
+
+// program
+
+namespace SnowGL
+{
+	/*! @struct ObjectTransform
+	*	@brief The transforms of an object, as read by the shaders: 7 RGBA32F texels of the buffer texture
+	*/
+	struct ObjectTransform
+	{
+		glm::mat4	modelMatrix;		/**< Model matrix (texels 0-3, one per column) */
+		glm::vec4	normalMatrix[3];	/**< Columns of the normal matrix in world coordinates, inverse transpose of the model matrix (texels 4-6) */
+
+		/** @brief Writes the transforms of a model matrix
+		*	@param _model The model matrix
+		*/
+		inline void set(const glm::mat4 &_model)
+		{
+			glm::mat3 normal = glm::inverseTranspose(glm::mat3(_model));
+			modelMatrix = _model;
+			normalMatrix[0] = glm::vec4(normal[0], 0.0f);
+			normalMatrix[1] = glm::vec4(normal[1], 0.0f);
+			normalMatrix[2] = glm::vec4(normal[2], 0.0f);
+		}
+	};
+
+	static_assert(sizeof(ObjectTransform) == 7 * 4 * sizeof(float), "ObjectTransform must be 7 RGBA32F texels");
+
+	/*! @class TransformRing
+	*	@brief The transforms of the objects drawn in a frame, in a triple-buffered ring read through a buffer texture
+	*
+	*	The buffer has a segment for each of the last FRAMES frames. A frame writes only its own segment, and a fence
+	*	placed after its draws tells when the GPU is done with it: the segment is written again FRAMES frames later,
+	*	after waiting for the fence (normally already signaled). With OpenGL 4.4 the buffer is mapped once, persistent
+	*	and coherent; otherwise the segment of the frame is mapped unsynchronized at the beginning of the frame and
+	*	unmapped by flush(), before the draws.
+	*	A draw selects its object with the index returned by push() or allocate(), so there is no matrix upload per draw.
+	*	The scene shaders target OpenGL 4.1, which has no shader storage buffers, so the ring is read with texelFetch
+	*	from a samplerBuffer.
+	*/
+	class TransformRing
+	{
+	public:
+		static const int FRAMES = 3;			/**< The number of frames whose segments can be in use by the GPU */
+		static const int TEXELS_PER_OBJECT = 7;	/**< The RGBA32F texels of an ObjectTransform */
+
+		TransformRing() = default;
+		~TransformRing() { destroy(); }
+
+		TransformRing(const TransformRing &) = delete;
+		TransformRing &operator=(const TransformRing &) = delete;
+
+		/** @brief Creates the buffer and its buffer texture
+		*	@param _capacity The maximum number of objects in a frame (reduced if the buffer texture would be too large)
+		*/
+		void create(int _capacity)
+		{
+			destroy();
+			GLint maxTexels = 0;
+			glGetIntegerv(GL_MAX_TEXTURE_BUFFER_SIZE, &maxTexels);
+			m_capacity = std::min(_capacity, maxTexels / (FRAMES * TEXELS_PER_OBJECT));
+			GLsizeiptr size = (GLsizeiptr)FRAMES * m_capacity * sizeof(ObjectTransform);
+
+			glGenBuffers(1, &m_buffer);
+			glBindBuffer(GL_TEXTURE_BUFFER, m_buffer);
+			m_persistent = GLAD_GL_VERSION_4_4 != 0;
+			if (m_persistent)
+			{
+				const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+				glBufferStorage(GL_TEXTURE_BUFFER, size, nullptr, flags);
+				m_mapped = (ObjectTransform *)glMapBufferRange(GL_TEXTURE_BUFFER, 0, size, flags);
+			}
+			else
+				glBufferData(GL_TEXTURE_BUFFER, size, nullptr, GL_STREAM_DRAW);
+			glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+			glGenTextures(1, &m_texture);
+			glBindTexture(GL_TEXTURE_BUFFER, m_texture);
+			glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, m_buffer);
+			glBindTexture(GL_TEXTURE_BUFFER, 0);
+			m_frame = 0;
+			m_count = 0;
+		}
+
+		/** @brief Deletes the buffer, the texture and the fences
+		*/
+		void destroy()
+		{
+			if (m_buffer == 0)
+				return;
+			for (int i = 0; i < FRAMES; ++i)
+			{
+				if (m_fences[i])
+					glDeleteSync(m_fences[i]);
+				m_fences[i] = nullptr;
+			}
+			glDeleteTextures(1, &m_texture);
+			// the buffer is unmapped when it is deleted
+			glDeleteBuffers(1, &m_buffer);
+			m_buffer = m_texture = 0;
+			m_mapped = nullptr;
+			m_segment = nullptr;
+		}
+
+		/** @brief Starts a frame: it waits until the GPU is done with the segment of the frame, and maps it if needed
+		*/
+		void beginFrame()
+		{
+			int index = (int)(m_frame % FRAMES);
+			GLsync &fence = m_fences[index];
+			if (fence)
+			{
+				if (glClientWaitSync(fence, 0, 0) == GL_TIMEOUT_EXPIRED)
+				{
+					++m_waits;
+					while (glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000) == GL_TIMEOUT_EXPIRED)
+						;
+				}
+				glDeleteSync(fence);
+				fence = nullptr;
+			}
+
+			GLintptr offset = (GLintptr)index * m_capacity * sizeof(ObjectTransform);
+			if (m_persistent)
+				m_segment = m_mapped + (size_t)index * m_capacity;
+			else
+			{
+				glBindBuffer(GL_TEXTURE_BUFFER, m_buffer);
+				m_segment = (ObjectTransform *)glMapBufferRange(GL_TEXTURE_BUFFER, offset, m_capacity * sizeof(ObjectTransform),
+					GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+				glBindBuffer(GL_TEXTURE_BUFFER, 0);
+			}
+			m_count = 0;
+		}
+
+		/** @brief Reserves the transforms of consecutive objects in the current frame
+		*	@param _count The number of objects
+		*	@param _first The index of the first object, for the shaders
+		*	@return The transforms to write, or nullptr if the frame is full
+		*/
+		ObjectTransform *allocate(int _count, GLint &_first)
+		{
+			if (!m_segment || m_count + _count > m_capacity)
+				return nullptr;
+			_first = (GLint)((m_frame % FRAMES) * m_capacity + m_count);
+			ObjectTransform *transforms = m_segment + m_count;
+			m_count += _count;
+			return transforms;
+		}
+
+		/** @brief Writes the transforms of an object in the current frame
+		*	@param _model The model matrix
+		*	@return The index of the object for the shaders, or -1 if the frame is full
+		*/
+		GLint push(const glm::mat4 &_model)
+		{
+			GLint index = -1;
+			ObjectTransform *transform = allocate(1, index);
+			if (transform)
+				transform->set(_model);
+			return index;
+		}
+
+		/** @brief Ends the writes of the frame: it must be called before the draws which read the transforms
+		*/
+		void flush()
+		{
+			if (m_persistent || !m_segment)
+				return;
+			glBindBuffer(GL_TEXTURE_BUFFER, m_buffer);
+			glUnmapBuffer(GL_TEXTURE_BUFFER);
+			glBindBuffer(GL_TEXTURE_BUFFER, 0);
+			m_segment = nullptr;
+		}
+
+		/** @brief Ends the frame: the fence is placed after the draws which read the segment
+		*/
+		void endFrame()
+		{
+			flush();
+			m_fences[m_frame % FRAMES] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+			m_segment = nullptr;
+			++m_frame;
+		}
+
+		/** @brief Binds the buffer texture
+		*	@param _unit The texture unit (0 for GL_TEXTURE0)
+		*/
+		inline void bind(GLuint _unit) const
+		{
+			glActiveTexture(GL_TEXTURE0 + _unit);
+			glBindTexture(GL_TEXTURE_BUFFER, m_texture);
+		}
+
+		/** @brief Capacity getter
+		*	@return The maximum number of objects in a frame
+		*/
+		inline int getCapacity() const { return m_capacity; }
+
+		/** @brief Count getter
+		*	@return The number of objects written in the current frame
+		*/
+		inline int getCount() const { return m_count; }
+
+		/** @brief Persistent mapping getter
+		*	@return true if the buffer is mapped once (OpenGL 4.4)
+		*/
+		inline bool isPersistent() const { return m_persistent; }
+
+		/** @brief Waits getter
+		*	@return The number of frames which had to wait for the GPU before writing their segment
+		*/
+		inline unsigned long long getWaits() const { return m_waits; }
+
+	private:
+		GLuint				m_buffer = 0;
+		GLuint				m_texture = 0;
+		GLsync				m_fences[FRAMES] = {};
+		ObjectTransform		*m_mapped = nullptr;	// the whole buffer, when it is mapped persistently
+		ObjectTransform		*m_segment = nullptr;	// the segment of the current frame, while it can be written
+		int					m_capacity = 0;
+		int					m_count = 0;
+		bool				m_persistent = false;
+		unsigned long long	m_frame = 0;
+		unsigned long long	m_waits = 0;
+	};
+}
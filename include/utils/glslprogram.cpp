@@ -1,8 +1,10 @@
 #include "glslprogram.h"
 
 #include "glutils.h"
+#include "Profiler.h"
 #include <iostream>
 #include <fstream>
+#include <cstring>
 
 using std::ifstream;
 using std::ios;
@@ -120,6 +122,7 @@ void GLSLProgram::compileShader(const char *fileName,
 void GLSLProgram::compileShader(const string &source,
                                 GLSLShader::GLSLShaderType type,
                                 const char *fileName) {
+    SNOWGL_PROFILE_SCOPE_DETAIL("CompileShader", fileName);
     if (handle <= 0) {
         handle = glCreateProgram();
         if (handle == 0) {
@@ -168,6 +171,7 @@ void GLSLProgram::compileShader(const string &source,
 
 void GLSLProgram::link() {
     if (linked) return;
+    SNOWGL_PROFILE_SCOPE("LinkProgram");
     if (handle <= 0)
         throw GLSLProgramException("Program has not been compiled.");
 
@@ -203,59 +207,56 @@ void GLSLProgram::link() {
 }
 
 void GLSLProgram::findUniformLocations() {
-    uniformLocations.clear();
+    uniformTable.clear();
+    uniformNames.clear();
 
-    GLint numUniforms = 4;
-#ifdef __APPLE__
-    // For OpenGL 4.1, use glGetActiveUniform
+    // the active uniforms are enumerated with glGetActiveUniform, available since OpenGL 2.0:
+    // the locations are assigned by the driver, and they cannot be assumed
+    GLint numUniforms = 0;
     GLint maxLen;
     GLchar *name;
 
     glGetProgramiv(handle, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLen);
     glGetProgramiv(handle, GL_ACTIVE_UNIFORMS, &numUniforms);
 
+    // the names are stored first, so the table can point to them; an array is found
+    // both as "name[0]" and as "name"
+    std::vector<GLint> locations;
     name = new GLchar[maxLen];
-    for (GLuint i = 0; i < numUniforms; ++i) {
+    for (GLint i = 0; i < numUniforms; ++i) {
         GLint size;
         GLenum type;
         GLsizei written;
         glGetActiveUniform(handle, i, maxLen, &written, &size, &type, name);
         GLint location = glGetUniformLocation(handle, name);
-        uniformLocations[name] = glGetUniformLocation(handle, name);
+        if (location < 0) continue;  // uniforms in blocks
+        uniformNames.push_back(string(name, written));
+        locations.push_back(location);
+        size_t bracket = uniformNames.back().find('[');
+        if (bracket != string::npos) {
+            uniformNames.push_back(uniformNames.back().substr(0, bracket));
+            locations.push_back(location);
+        }
     }
     delete[] name;
-#else
-    // For OpenGL 4.3 and above, use glGetProgramResource
-    // std::cout << 
-    //     handle << std::endl;
-    // glGetProgramResourceiv( handle, GL_UNIFORM, GL_ACTIVE_RESOURCES, &numUniforms);
 
-    GLenum properties[] = {GL_NAME_LENGTH, GL_TYPE, GL_LOCATION, GL_BLOCK_INDEX};
-   std::cout << 
-        "Getting properties" << std::endl;
-//     for( GLint i = 0; i < numUniforms; ++i ) {
-//       GLint results[4];
-//       glGetProgramResourceiv(handle, GL_UNIFORM, i, 4, properties, 4, NULL, results);
-// std::cout << 
-//         "Getting properties" << std::endl;
-//       if( results[3] != -1 ) continue;  // Skip uniforms in blocks
-//       GLint nameBufSize = results[0] + 1;
-//       char * name = new char[nameBufSize];
-//       glGetProgramResourceName(handle, GL_UNIFORM, i, nameBufSize, NULL, name);
-//       uniformLocations[name] = results[2];
-//       delete [] name;
-//        std::cout << 
-//         "Dones" << std::endl;
-//     }
-        uniformLocations["Time"] = 0;
-        uniformLocations["H"] = 1;
-        uniformLocations["Accel"] = 2;
-        uniformLocations["ParticleLifetime"] = 4;
-        uniformLocations["MVP"] = 3;
-        uniformLocations["ParticleTex"] = 5;
-               std::cout << 
-        "Dones" << std::endl;
-#endif
+    size_t capacity = 8;
+    while (capacity < 2 * uniformNames.size()) capacity *= 2;
+    UniformSlot empty = {0, -1, NULL};
+    uniformTable.assign(capacity, empty);
+    for (size_t i = 0; i < uniformNames.size(); ++i)
+        insertUniform(uniformNames[i], locations[i]);
+}
+
+void GLSLProgram::insertUniform(const string &name, GLint location) {
+    uint32_t hash = GLSLUniform::hashName(name.c_str());
+    size_t mask = uniformTable.size() - 1;
+    size_t i = hash & mask;
+    while (uniformTable[i].name != NULL)
+        i = (i + 1) & mask;
+    uniformTable[i].hash = hash;
+    uniformTable[i].location = location;
+    uniformTable[i].name = name.c_str();
 }
 
 void GLSLProgram::use() {
@@ -281,52 +282,52 @@ void GLSLProgram::bindFragDataLocation(GLuint location, const char *name) {
     glBindFragDataLocation(handle, location, name);
 }
 
-void GLSLProgram::setUniform(const char *name, float x, float y, float z) {
-    GLint loc = getUniformLocation(name);
+void GLSLProgram::setUniform(const GLSLUniform &uniform, float x, float y, float z) {
+    GLint loc = getUniformLocation(uniform);
     glUniform3f(loc, x, y, z);
 }
 
-void GLSLProgram::setUniform(const char *name, const glm::vec3 &v) {
-    this->setUniform(name, v.x, v.y, v.z);
+void GLSLProgram::setUniform(const GLSLUniform &uniform, const glm::vec3 &v) {
+    this->setUniform(uniform, v.x, v.y, v.z);
 }
 
-void GLSLProgram::setUniform(const char *name, const glm::vec4 &v) {
-    GLint loc = getUniformLocation(name);
+void GLSLProgram::setUniform(const GLSLUniform &uniform, const glm::vec4 &v) {
+    GLint loc = getUniformLocation(uniform);
     glUniform4f(loc, v.x, v.y, v.z, v.w);
 }
 
-void GLSLProgram::setUniform(const char *name, const glm::vec2 &v) {
-    GLint loc = getUniformLocation(name);
+void GLSLProgram::setUniform(const GLSLUniform &uniform, const glm::vec2 &v) {
+    GLint loc = getUniformLocation(uniform);
     glUniform2f(loc, v.x, v.y);
 }
 
-void GLSLProgram::setUniform(const char *name, const glm::mat4 &m) {
-    GLint loc = getUniformLocation(name);
+void GLSLProgram::setUniform(const GLSLUniform &uniform, const glm::mat4 &m) {
+    GLint loc = getUniformLocation(uniform);
     glUniformMatrix4fv(loc, 1, GL_FALSE, &m[0][0]);
 }
 
-void GLSLProgram::setUniform(const char *name, const glm::mat3 &m) {
-    GLint loc = getUniformLocation(name);
+void GLSLProgram::setUniform(const GLSLUniform &uniform, const glm::mat3 &m) {
+    GLint loc = getUniformLocation(uniform);
     glUniformMatrix3fv(loc, 1, GL_FALSE, &m[0][0]);
 }
 
-void GLSLProgram::setUniform(const char *name, float val) {
-    GLint loc = getUniformLocation(name);
+void GLSLProgram::setUniform(const GLSLUniform &uniform, float val) {
+    GLint loc = getUniformLocation(uniform);
     glUniform1f(loc, val);
 }
 
-void GLSLProgram::setUniform(const char *name, int val) {
-    GLint loc = getUniformLocation(name);
+void GLSLProgram::setUniform(const GLSLUniform &uniform, int val) {
+    GLint loc = getUniformLocation(uniform);
     glUniform1i(loc, val);
 }
 
-void GLSLProgram::setUniform(const char *name, GLuint val) {
-    GLint loc = getUniformLocation(name);
+void GLSLProgram::setUniform(const GLSLUniform &uniform, GLuint val) {
+    GLint loc = getUniformLocation(uniform);
     glUniform1ui(loc, val);
 }
 
-void GLSLProgram::setUniform(const char *name, bool val) {
-    int loc = getUniformLocation(name);
+void GLSLProgram::setUniform(const GLSLUniform &uniform, bool val) {
+    int loc = getUniformLocation(uniform);
     glUniform1i(loc, val);
 }
 
@@ -548,14 +549,18 @@ void GLSLProgram::validate() {
     }
 }
 
-int GLSLProgram::getUniformLocation(const char *name) {
-    auto pos = uniformLocations.find(name);
+GLint GLSLProgram::getUniformLocation(const GLSLUniform &uniform) const {
+    if (uniformTable.empty()) return -1;
 
-    if (pos == uniformLocations.end()) {
-        uniformLocations[name] = glGetUniformLocation(handle, name);
+    // the name is compared only when the hash matches; an inactive uniform ends on an
+    // empty slot and gets -1, which glUniform* ignores
+    size_t mask = uniformTable.size() - 1;
+    for (size_t i = uniform.hash & mask; uniformTable[i].name != NULL; i = (i + 1) & mask) {
+        const UniformSlot &slot = uniformTable[i];
+        if (slot.hash == uniform.hash && strcmp(slot.name, uniform.name) == 0)
+            return slot.location;
     }
-
-    return uniformLocations[name];
+    return -1;
 }
 
 bool GLSLProgram::fileExists(const string &fileName) {
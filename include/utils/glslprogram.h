@@ -6,8 +6,9 @@
 
 #include <glad/glad.h>
 
+#include <cstdint>
 #include <string>
-#include <map>
+#include <vector>
 #include <glm/glm.hpp>
 #include <stdexcept>
 
@@ -28,13 +29,41 @@ namespace GLSLShader {
     };
 };
 
+// The name of a uniform, with its FNV-1a hash. The constructor is constexpr, so a
+// handle declared constexpr (or built from a literal in an optimized build) is
+// hashed at compile time, and setUniform does not hash or copy the name.
+// The name must outlive the handle (string literals do).
+class GLSLUniform {
+public:
+    constexpr GLSLUniform(const char *name) : name(name), hash(hashName(name)) {}
+
+    static constexpr uint32_t hashName(const char *s, uint32_t h = 2166136261u) {
+        return *s ? hashName(s + 1, (h ^ (uint8_t) *s) * 16777619u) : h;
+    }
+
+    const char *name;
+    uint32_t hash;
+};
+
 class GLSLProgram {
 private:
+    // A slot of the open-addressed table of the uniform locations, filled at link time.
+    // The table has a power of two size, at least twice the number of uniforms, and
+    // it is searched with linear probing; a slot with a NULL name is empty.
+    struct UniformSlot {
+        uint32_t hash;
+        GLint location;
+        const char *name;
+    };
+
     GLuint handle;
     bool linked;
-    std::map<std::string, int> uniformLocations;
+    std::vector<UniformSlot> uniformTable;
+    std::vector<std::string> uniformNames;  // storage of the names in the table
+
+    GLint getUniformLocation(const GLSLUniform &uniform) const;
 
-    GLint getUniformLocation(const char *name);
+    void insertUniform(const std::string &name, GLint location);
 
     bool fileExists(const std::string &fileName);
 
@@ -71,25 +100,25 @@ public:
 
     void bindFragDataLocation(GLuint location, const char *name);
 
-    void setUniform(const char *name, float x, float y, float z);
+    void setUniform(const GLSLUniform &uniform, float x, float y, float z);
 
-    void setUniform(const char *name, const glm::vec2 &v);
+    void setUniform(const GLSLUniform &uniform, const glm::vec2 &v);
 
-    void setUniform(const char *name, const glm::vec3 &v);
+    void setUniform(const GLSLUniform &uniform, const glm::vec3 &v);
 
-    void setUniform(const char *name, const glm::vec4 &v);
+    void setUniform(const GLSLUniform &uniform, const glm::vec4 &v);
 
-    void setUniform(const char *name, const glm::mat4 &m);
+    void setUniform(const GLSLUniform &uniform, const glm::mat4 &m);
 
-    void setUniform(const char *name, const glm::mat3 &m);
+    void setUniform(const GLSLUniform &uniform, const glm::mat3 &m);
 
-    void setUniform(const char *name, float val);
+    void setUniform(const GLSLUniform &uniform, float val);
 
-    void setUniform(const char *name, int val);
+    void setUniform(const GLSLUniform &uniform, int val);
 
-    void setUniform(const char *name, bool val);
+    void setUniform(const GLSLUniform &uniform, bool val);
 
-    void setUniform(const char *name, GLuint val);
+    void setUniform(const GLSLUniform &uniform, GLuint val);
 
     void findUniformLocations();
 
@@ -31,6 +31,9 @@ using namespace std;
 // Std. Includes
 #include <vector>
 
+// bounding volumes of the meshes, for the frustum culling
+#include <utils/Bounds.h>
+
 // data structure for vertices
 struct Vertex {
     // vertex coordinates
@@ -53,6 +56,9 @@ public:
     vector<GLuint> indices;
     // VAO
     GLuint VAO;
+    // bounding box and bounding sphere of the vertices, in model coordinates
+    SnowGL::AABB bounds;
+    SnowGL::BoundingSphere sphere;
 
     // We want Mesh to be a move-only class. We delete copy constructor and copy assignment
     // see:
@@ -71,6 +77,7 @@ public:
         : vertices(std::move(vertices)), indices(std::move(indices))
     {
         this->setupMesh();
+        this->computeBounds();
     }
 
     // We implement a user-defined move constructor and move assignment
@@ -88,7 +95,7 @@ public:
     Mesh(Mesh&& move) noexcept
         // Calls move for both vectors, which internally consists of a simple pointer swap between the new instance and the source one.
         : vertices(std::move(move.vertices)), indices(std::move(move.indices)),
-        VAO(move.VAO), VBO(move.VBO), EBO(move.EBO)
+        VAO(move.VAO), bounds(move.bounds), sphere(move.sphere), VBO(move.VBO), EBO(move.EBO)
     {
         move.VAO = 0; // We *could* set VBO and EBO to 0 too,
         // but since we bring all the 3 values around we can use just one of them to check ownership of the 3 resources.
@@ -105,6 +112,8 @@ public:
             vertices = std::move(move.vertices);
             indices = std::move(move.indices);
             VAO = move.VAO;
+            bounds = move.bounds;
+            sphere = move.sphere;
             VBO = move.VBO;
             EBO = move.EBO;
 
@@ -185,6 +194,17 @@ private:
         glBindVertexArray(0);
     }
 
+    //////////////////////////////////////////
+    // we compute the bounding volumes once, at loading: the sphere is centered in the box, and its radius is the
+    // distance of the farthest vertex from the center
+    void computeBounds()
+    {
+        for (const Vertex& vertex : this->vertices)
+            this->bounds.expand(vertex.Position);
+        if (!this->vertices.empty())
+            this->sphere = SnowGL::BoundingSphere::fromPoints(this->bounds, &this->vertices[0].Position, this->vertices.size(), sizeof(Vertex));
+    }
+
     //////////////////////////////////////////
 
     void freeGPUresources()
@@ -34,12 +34,18 @@ using namespace std;
 // we include the Mesh class, which manages the "OpenGL side" (= creation and allocation of VBO, VAO, EBO buffers) of the loading of models
 #include <utils/mesh_v1.h>
 
+// scoped zones of the CPU profiler
+#include <utils/Profiler.h>
+
 /////////////////// MODEL class ///////////////////////
 class Model
 {
 public:
     // at the end of loading, we will have a vector of Mesh class instances
     vector<Mesh> meshes;
+    // bounding box and bounding sphere of all the meshes, in model coordinates
+    SnowGL::AABB bounds;
+    SnowGL::BoundingSphere sphere;
 
     //////////////////////////////////////////
 
@@ -70,7 +76,9 @@ public:
     // because we are not writing a user-defined destructor.
     Model(const string& path)
     {
+        SNOWGL_PROFILE_SCOPE_DETAIL("LoadModel", path.c_str());
         this->loadModel(path);
+        this->computeBounds();
     }
 
     //////////////////////////////////////////
@@ -87,6 +95,24 @@ public:
 
 private:
 
+    //////////////////////////////////////////
+    // the box contains the boxes of the meshes; the sphere is centered in it, and it contains all the vertices
+    void computeBounds()
+    {
+        for(const Mesh& mesh : this->meshes)
+            this->bounds.expand(mesh.bounds);
+        if (this->bounds.isEmpty())
+            return;
+        this->sphere.center = this->bounds.getCenter();
+        this->sphere.radius = 0.0f;
+        for(const Mesh& mesh : this->meshes)
+            if (!mesh.vertices.empty())
+            {
+                SnowGL::BoundingSphere meshSphere = SnowGL::BoundingSphere::fromPoints(this->bounds, &mesh.vertices[0].Position, mesh.vertices.size(), sizeof(Vertex));
+                this->sphere.radius = std::max(this->sphere.radius, meshSphere.radius);
+            }
+    }
+
     //////////////////////////////////////////
     // loading of the model using Assimp library. Nodes are processed to build a vector of Mesh class instances
     void loadModel(string path)
@@ -20,6 +20,31 @@ using namespace std;
 #include <fstream>
 #include <sstream>
 #include <iostream>
+#include <vector>
+
+// GLM types of the uniform handles
+#include <glm/glm.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+// scoped zones of the CPU profiler
+#include <utils/Profiler.h>
+
+/////////////////// UNIFORM HANDLES ///////////////////////
+// typed handle of a uniform of a Shader Program, resolved once after the link (see Shader::GetUniform)
+// the type of the handle selects the glUniform* call, so a value of the wrong type does not compile
+template <typename T>
+struct UniformHandle
+{
+    GLint location = -1;
+};
+
+// the GLSL types accepted by each type of handle
+template <typename T> struct UniformTypeOf;
+template <> struct UniformTypeOf<GLfloat> { static bool Matches(GLenum type) { return type == GL_FLOAT; } };
+template <> struct UniformTypeOf<GLint> { static bool Matches(GLenum type) { return type == GL_INT || type == GL_BOOL || type == GL_SAMPLER_2D || type == GL_SAMPLER_2D_SHADOW || type == GL_SAMPLER_2D_ARRAY || type == GL_SAMPLER_2D_ARRAY_SHADOW || type == GL_SAMPLER_CUBE || type == GL_SAMPLER_BUFFER; } };
+template <> struct UniformTypeOf<glm::vec3> { static bool Matches(GLenum type) { return type == GL_FLOAT_VEC3; } };
+template <> struct UniformTypeOf<glm::mat3> { static bool Matches(GLenum type) { return type == GL_FLOAT_MAT3; } };
+template <> struct UniformTypeOf<glm::mat4> { static bool Matches(GLenum type) { return type == GL_FLOAT_MAT4; } };
 
 /////////////////// SHADER class ///////////////////////
 class Shader
@@ -27,11 +52,23 @@ class Shader
 public:
     GLuint Program;
     bool particleEnabled = false;
+
+    // an active uniform of the Shader Program
+    struct ActiveUniform
+    {
+        string name;
+        GLenum type;
+        GLint size;
+        GLint location;
+    };
+    // the active uniforms of the Shader Program, read once after the link
+    vector<ActiveUniform> Uniforms;
     //////////////////////////////////////////
 
     //constructor
     Shader(const GLchar* vertexPath, const GLchar* fragmentPath)
     {
+        SNOWGL_PROFILE_SCOPE_DETAIL("CompileShader", vertexPath);
         // Step 1: we retrieve shaders source code from provided filepaths
         string vertexCode;
         string fragmentCode;
@@ -102,8 +139,43 @@ public:
         // Step 4: we delete the shaders because they are linked to the Shader Program, and we do not need them anymore
         glDeleteShader(vertex);
         glDeleteShader(fragment);
+
+        // Step 5: we read the list of active uniforms, so the render loop does not need to search them by name
+        this->ReflectUniforms();
+    }
+
+    //////////////////////////////////////////
+
+    // it returns the handle of an active uniform. It must be called after the link, not in the render loop:
+    // a missing uniform, or a uniform of a different type, is reported on the console and gives a handle ignored by Set()
+    template <typename T>
+    UniformHandle<T> GetUniform(const string& name) const
+    {
+        UniformHandle<T> handle;
+        for (const ActiveUniform& uniform : this->Uniforms)
+        {
+            if (uniform.name != name)
+                continue;
+            if (UniformTypeOf<T>::Matches(uniform.type))
+                handle.location = uniform.location;
+            else
+                cout << "WARNING::SHADER:: uniform " << name << " has GLSL type 0x" << hex << uniform.type << dec << ", not the type of the handle" << endl;
+            return handle;
+        }
+        cout << "WARNING::SHADER:: uniform " << name << " is not active" << endl;
+        return handle;
     }
 
+    // they set the value of a uniform of the Shader Program currently in use
+    void Set(UniformHandle<GLfloat> handle, GLfloat value) const { glUniform1f(handle.location, value); }
+    void Set(UniformHandle<GLint> handle, GLint value) const { glUniform1i(handle.location, value); }
+    void Set(UniformHandle<glm::vec3> handle, const glm::vec3& value) const { glUniform3fv(handle.location, 1, glm::value_ptr(value)); }
+    void Set(UniformHandle<glm::mat3> handle, const glm::mat3& value) const { glUniformMatrix3fv(handle.location, 1, GL_FALSE, glm::value_ptr(value)); }
+    void Set(UniformHandle<glm::mat4> handle, const glm::mat4& value) const { glUniformMatrix4fv(handle.location, 1, GL_FALSE, glm::value_ptr(value)); }
+    // the same for arrays: count values, from the first element
+    void Set(UniformHandle<GLfloat> handle, const GLfloat* values, GLsizei count) const { glUniform1fv(handle.location, count, values); }
+    void Set(UniformHandle<glm::mat4> handle, const glm::mat4* values, GLsizei count) const { glUniformMatrix4fv(handle.location, count, GL_FALSE, glm::value_ptr(values[0])); }
+
     //////////////////////////////////////////
 
     // We activate the Shader Program as part of the current rendering process
@@ -118,6 +190,32 @@ public:
 private:
     //////////////////////////////////////////
 
+    // it fills the Uniforms vector with the active uniforms of the Shader Program (the names of arrays lose the "[0]" suffix)
+    void ReflectUniforms()
+    {
+        GLint count = 0, maxLength = 0;
+        glGetProgramiv(this->Program, GL_ACTIVE_UNIFORMS, &count);
+        glGetProgramiv(this->Program, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+        vector<GLchar> name(maxLength > 0 ? maxLength : 1);
+        for (GLint i = 0; i < count; ++i)
+        {
+            ActiveUniform uniform;
+            GLsizei length = 0;
+            glGetActiveUniform(this->Program, (GLuint)i, (GLsizei)name.size(), &length, &uniform.size, &uniform.type, name.data());
+            uniform.name.assign(name.data(), length);
+            // the uniforms in blocks have no location
+            uniform.location = glGetUniformLocation(this->Program, uniform.name.c_str());
+            if (uniform.location < 0)
+                continue;
+            size_t bracket = uniform.name.find('[');
+            if (bracket != string::npos)
+                uniform.name.resize(bracket);
+            this->Uniforms.push_back(uniform);
+        }
+    }
+
+    //////////////////////////////////////////
+
     // Check compilation and linking errors
     void checkCompileErrors(GLuint shader, string type)
 	{